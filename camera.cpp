@@ -9,6 +9,7 @@ Camera::Camera() {
 
 	// default position, pointing at center along z axis
 	mCameraPosition = CENTER;
+	mPreviousPosition = CENTER;
 	mCameraPointsAt = -Z_AXIS;
 	mCameraHorizontalAxis = X_AXIS;
 	mCameraVerticalAxis = Y_AXIS;
@@ -19,28 +20,55 @@ Camera::Camera() {
 
 	// default FOV
 	mFieldOfView = 45.0f;
+
+	mDirty = true;
 }
 
 void Camera::setPosition(float x, float y, float z) {
 	mCameraPosition = glm::vec3(x, y, z);
+	mPreviousPosition = mCameraPosition; // placed, not moved: nothing to blend from
+	mDirty = true;
 }
 
 void Camera::setFieldOfView(float angle) {
 	mFieldOfView = angle;
+	mDirty = true;
+}
+
+void Camera::lookAt(const glm::vec3& position, const glm::vec3& target) {
+
+	mCameraPosition = position;
+	mPreviousPosition = position;
+	mDirty = true;
+	glm::vec3 heading = target - position;
+	if (glm::length(heading) < 1e-6f) return; // keep the old heading rather than divide by zero
+	mCameraPointsAt = glm::normalize(heading);
+
+	// the polar angles rotate() works from, so mouse input continues smoothly from here
+	mRotationX = atan2(mCameraPointsAt.z, mCameraPointsAt.x);
+	mRotationY = asin(std::clamp(mCameraPointsAt.y, -1.0f, 1.0f));
+
+	alignAxes();
 }
 
 float Camera::getFieldOfView() {
 	return mFieldOfView;
 }
 
-glm::mat4 Camera::getView() {
-	return glm::lookAt(mCameraPosition, mCameraPosition + mCameraPointsAt, Y_AXIS);
+glm::mat4 Camera::getView(float alpha) {
+	glm::vec3 position = getPosition(alpha);
+	return glm::lookAt(position, position + mCameraPointsAt, Y_AXIS);
+}
+
+glm::vec3 Camera::getPosition(float alpha) {
+	return glm::mix(mPreviousPosition, mCameraPosition, alpha);
 }
 
 void Camera::move(CameraDirection direction, float frameTime) {
 
 	// modulate movement speed by frame render speed, faster frames mean less movement per frame
 	float movementSpeed = mPanSpeed * frameTime;
+	if (direction != CameraDirection::NONE) mDirty = true;
 
 	switch (direction) {
 
@@ -81,6 +109,7 @@ void Camera::rotate(float x, float y) {
 	// modulate raw rotation delta by speed
 	mRotationX += x * mRotateSpeed;
 	mRotationY += y * mRotateSpeed;
+	mDirty = true;
 
 	// constrain up/down rotation to 180 degrees
 	mRotationY = std::clamp(mRotationY, -0.5f * 3.14159f, 0.5f * 3.14159f);
@@ -90,10 +119,14 @@ void Camera::rotate(float x, float y) {
 	auto yCircle = glm::vec3(cos(mRotationY), sin(mRotationY), cos(mRotationY));
 	mCameraPointsAt = glm::normalize(xCircle * yCircle); // camera aims at this point in space, which is on a unit sphere
 
+	alignAxes();
+}
+
+void Camera::alignAxes() {
+
 	// align the vertical and horizontal axes with the new camera heading
 	mCameraHorizontalAxis = glm::normalize(glm::cross(mCameraPointsAt, Y_AXIS)); //align camera left right pan to new axis
 	mCameraVerticalAxis = glm::normalize(glm::cross(mCameraHorizontalAxis, mCameraPointsAt));
-	
 }
 
 void Camera::changeMovementSpeed(float scale) {
@@ -37,6 +37,9 @@ class Camera {
 		void setPosition(float x, float y, float z);
 		void setFieldOfView(float angle);
 
+		// place and aim the camera directly (scripted paths), mouse rotation carries on from the new heading
+		void lookAt(const glm::vec3& position, const glm::vec3& target);
+
 	private:
 
 	#define CENTER glm::vec3(0,0,0)
@@ -47,11 +50,15 @@ class Camera {
 		// define camera scene position information
 		glm::vec3 mCameraPointsAt; // "front", where the camera aims. front back control moves on this axis
 		glm::vec3 mCameraPosition; // transform position in world space
+		glm::vec3 mPreviousPosition; // position at the start of the current simulation step, rendering blends from it
 		glm::vec3 mCameraHorizontalAxis; // left right control moves on this axis, which must change with rotation
 		glm::vec3 mCameraVerticalAxis; // up down moves on this axis, w.m.c.w.r.
 		float mRotationX; // camera horizontal rotation (to world space)
 		float mRotationY; // camera vertical rotation (tws)
 
+		// set by anything that moves, turns or zooms the camera, cleared by the controller once it has drawn the change
+		bool mDirty;
+
 		// define movement speed bounds
 		const float PAN_SPEED_MAX = 10.0f;
 		const float PAN_SPEED_MIN = 1.0f;
@@ -71,9 +78,14 @@ class Camera {
 		float mFieldOfView;
 
 		// define primary functions
-		glm::mat4 getView();
+		// alpha blends the position from the previous simulation step to this one (mouse rotation is not blended, it is
+		// applied the frame it arrives)
+		glm::mat4 getView(float alpha = 1.0f);
+		glm::vec3 getPosition(float alpha = 1.0f);
+		void beginStep() { mPreviousPosition = mCameraPosition; }
 
 		void rotate(float x, float y);
+		void alignAxes(); // horizontal and vertical pan axes from the heading
 		void move(CameraDirection direction, float frameTime);
 		void changeMovementSpeed(float scale);
 		float getFieldOfView();
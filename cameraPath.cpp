@@ -0,0 +1,37 @@
+#include "cameraPath.h"
+
+#include <cmath>
+
+// uniform Catmull-Rom between p1 and p2, u in [0, 1]
+static glm::vec3 CatmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float u) {
+	float u2 = u * u;
+	float u3 = u2 * u;
+	return 0.5f * ((2.0f * p1)
+		+ (p2 - p0) * u
+		+ (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u2
+		+ (3.0f * p1 - p0 - 3.0f * p2 + p3) * u3);
+}
+
+CameraKey CameraPath::Sample(float t) const {
+
+	if (mKeys.empty()) return { glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+	if (mKeys.size() == 1) return mKeys[0];
+
+	int count = (int)mKeys.size();
+	float position = std::fmod(t / secondsPerKey, (float)count);
+	if (position < 0.0f) position += count;
+
+	int segment = (int)position;
+	float u = position - segment;
+
+	// closed loop, so the neighbours wrap
+	const CameraKey& k0 = mKeys[(segment + count - 1) % count];
+	const CameraKey& k1 = mKeys[segment % count];
+	const CameraKey& k2 = mKeys[(segment + 1) % count];
+	const CameraKey& k3 = mKeys[(segment + 2) % count];
+
+	return {
+		CatmullRom(k0.position, k1.position, k2.position, k3.position, u),
+		CatmullRom(k0.target, k1.target, k2.target, k3.target, u)
+	};
+}
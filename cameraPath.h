@@ -0,0 +1,40 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/*
+* Scripted camera movement for benchmarks: a closed Catmull-Rom spline through key positions, each with a
+* point to look at (interpolated the same way). The spline passes through every key and is smooth at them,
+* and sampling only depends on time, so every run sees exactly the same frames.
+*/
+
+struct CameraKey {
+	glm::vec3 position;
+	glm::vec3 target;
+};
+
+class CameraPath {
+
+	public:
+
+		// keys are evenly spaced in time, secondsPerKey apart, and the last one loops back to the first
+		explicit CameraPath(float secondsPerKey = 2.0f) : secondsPerKey(secondsPerKey) {}
+
+		void AddKey(const glm::vec3& position, const glm::vec3& target) { mKeys.push_back({ position, target }); }
+
+		// one full loop
+		float getDuration() const { return secondsPerKey * mKeys.size(); }
+
+		// camera at time t (seconds, wraps around)
+		CameraKey Sample(float t) const;
+
+	private:
+
+		float secondsPerKey;
+		std::vector<CameraKey> mKeys;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "framePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void FramePacer::SetTargetFps(double fps) {
+	targetFps = std::max(0.0, fps);
+	scheduled = false;
+	if (targetFps > 0.0) smoothedDelta = 1.0 / targetFps;
+}
+
+void FramePacer::WaitForNextFrame() {
+
+	if (targetFps <= 0.0 || !started || skipped) {
+		scheduled = false;
+		return;
+	}
+
+	// one period after the previous deadline, not after the previous wake up
+	Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+	Clock::time_point now = Clock::now();
+	if (!scheduled) nextDeadline = lastTick + period;
+	else nextDeadline += period;
+	if (now - nextDeadline > period) nextDeadline = now; // too far behind to catch up, start over from here
+	scheduled = true;
+	Clock::time_point deadline = nextDeadline;
+
+	// sleep in 1 ms steps while there is more time left than a sleep could overshoot by (mean + one deviation of
+	// the sleeps seen so far), so a coarse system timer cannot make the frame late
+	while (true) {
+		double remaining = Seconds(deadline - Clock::now());
+		double sleepError = sleepMean + (sleeps > 1 ? std::sqrt(sleepM2 / (sleeps - 1)) : 0.0);
+		if (remaining <= sleepError) break;
+
+		Clock::time_point before = Clock::now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		double slept = Seconds(Clock::now() - before);
+
+		sleeps++;
+		double delta = slept - sleepMean;
+		sleepMean += delta / sleeps;
+		sleepM2 += delta * (slept - sleepMean);
+	}
+
+	// the rest is too short to trust to the scheduler
+	while (Clock::now() < deadline) std::this_thread::yield();
+}
+
+bool FramePacer::Tick() {
+
+	Clock::time_point now = Clock::now();
+	if (!started || skipped) {
+		// no previous frame to measure from, keep moving at the last smoothed rate
+		lastTick = now;
+		started = true;
+		skipped = false;
+		return false;
+	}
+
+	double interval = Seconds(now - lastTick);
+	lastTick = now;
+	lastIntervalMs = interval * 1000.0;
+
+	smoothedDelta += (std::min(interval, MAX_DELTA) - smoothedDelta) * SMOOTHING;
+
+	count++;
+	double delta = lastIntervalMs - mean;
+	mean += delta / count;
+	m2 += delta * (lastIntervalMs - mean);
+	worst = std::max(worst, lastIntervalMs);
+	return true;
+}
+
+double FramePacer::getStdDevMs() const {
+	return count > 1 ? std::sqrt(m2 / (count - 1)) : 0.0;
+}
+
+void FramePacer::Reset() {
+	started = false;
+	scheduled = false;
+	skipped = false;
+	count = 0;
+	mean = 0.0;
+	m2 = 0.0;
+	worst = 0.0;
+}
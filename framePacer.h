@@ -0,0 +1,76 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <chrono>
+
+// how buffer swaps wait for the display
+enum class SwapMode {
+	IMMEDIATE, // no wait, tears
+	VSYNC, // every swap waits for vertical blank
+	ADAPTIVE, // waits, but a late frame swaps at once instead of waiting a whole extra refresh
+};
+
+/*
+* Frame pacing on steady_clock. Tick() once at the top of every frame measures the whole interval since the
+* previous one (input, update, render and swap waits included) and folds it into a smoothed delta, which is what
+* movement should be scaled by. With a frame rate cap, WaitForNextFrame() holds the frame until its slot comes
+* round: it sleeps while the deadline is further off than sleeps have been overshooting, then spins the rest.
+* Slots are a fixed period apart rather than a period after the last wake up, so overshoot is not carried into
+* the next frame; only a loop that falls more than a period behind starts the schedule over.
+*
+* A frame that was not rendered (idle on demand, a pause) should call Skip(), so the gap is not taken as a frame.
+*/
+class FramePacer {
+
+	public:
+
+		// 0 = uncapped
+		void SetTargetFps(double fps);
+		double getTargetFps() const { return targetFps; }
+
+		void WaitForNextFrame();
+		bool Tick(); // false when there was no previous frame to measure from (first frame, after Skip)
+		void Skip() { skipped = true; }
+
+		// seconds, for scaling movement
+		float getDelta() const { return (float)smoothedDelta; }
+		double getLastIntervalMs() const { return lastIntervalMs; }
+
+		// whole frame intervals since Reset
+		long long getFrames() const { return count; }
+		double getMeanMs() const { return count > 0 ? mean : 0.0; }
+		double getStdDevMs() const;
+		double getWorstMs() const { return worst; }
+		void Reset();
+
+	private:
+
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr double SMOOTHING = 0.2; // weight of the newest interval
+		static constexpr double MAX_DELTA = 0.1; // a longer frame (a stall, a window drag) moves as if it took this long
+
+		double Seconds(Clock::duration duration) const { return std::chrono::duration<double>(duration).count(); }
+
+		double targetFps = 0.0;
+		Clock::time_point nextDeadline;
+		bool scheduled = false; // nextDeadline follows on from the previous wait
+		Clock::time_point lastTick;
+		bool started = false;
+		bool skipped = false;
+		double smoothedDelta = 1.0 / 60.0;
+		double lastIntervalMs = 0.0;
+
+		// running mean and variance (Welford) of the intervals in ms
+		long long count = 0;
+		double mean = 0.0;
+		double m2 = 0.0;
+		double worst = 0.0;
+
+		// same, for how far sleep_for overshoots, which decides when to stop sleeping and spin
+		long long sleeps = 0;
+		double sleepMean = 0.002;
+		double sleepM2 = 0.0;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "frameStats.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdio>
+
+static double Percentile(const std::vector<double>& sorted, double fraction) {
+	size_t rank = (size_t)std::ceil(fraction * sorted.size());
+	return sorted[std::clamp(rank, (size_t)1, sorted.size()) - 1];
+}
+
+TimingSummary Summarize(const std::vector<double>& samples) {
+
+	TimingSummary summary;
+	if (samples.empty()) return summary;
+
+	std::vector<double> sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+
+	summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	summary.p50 = Percentile(sorted, 0.50);
+	summary.p95 = Percentile(sorted, 0.95);
+	summary.p99 = Percentile(sorted, 0.99);
+	summary.worstFrame = (int)(std::max_element(samples.begin(), samples.end()) - samples.begin());
+	summary.worst = samples[summary.worstFrame];
+	return summary;
+}
+
+// a JSON string literal, quotes included
+static std::string JsonString(const std::string& text) {
+	std::string quoted = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+			quoted += c;
+		}
+		else if ((unsigned char)c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+			quoted += escaped;
+		}
+		else quoted += c;
+	}
+	return quoted + "\"";
+}
+
+static void WriteSummary(std::ostream& out, const char* name, const std::vector<double>& samples) {
+	TimingSummary summary = Summarize(samples);
+	out << "      " << JsonString(name) << ": { \"mean\": " << summary.mean << ", \"p50\": " << summary.p50
+		<< ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << ", \"worst\": " << summary.worst
+		<< ", \"worstFrame\": " << summary.worstFrame << " }";
+}
+
+void WriteTimingsJson(std::ostream& out, const std::vector<FrameTimings>& runs) {
+
+	out << "[\n";
+	for (size_t i = 0; i < runs.size(); i++) {
+		const FrameTimings& run = runs[i];
+		out << "  {\n";
+		out << "    \"scene\": " << JsonString(run.scene) << ",\n";
+		out << "    \"frames\": " << run.frameMs.size() << ",\n";
+		out << "    \"timestep\": " << run.timestep << ",\n";
+		out << "    \"triangles\": " << run.triangles << ",\n";
+		out << "    \"drawCalls\": " << run.drawCalls << ",\n";
+		out << "    \"ms\": {\n";
+		WriteSummary(out, "cpu", run.cpuMs);
+		out << ",\n";
+		WriteSummary(out, "gpu", run.gpuMs);
+		out << ",\n";
+		WriteSummary(out, "frame", run.frameMs);
+		out << "\n    }\n";
+		out << "  }" << (i + 1 < runs.size() ? "," : "") << "\n";
+	}
+	out << "]\n";
+}
+
+void WriteFrameTimesCsv(std::ostream& out, const FrameTimings& run) {
+
+	out << "frame,cpu_ms,gpu_ms,frame_ms\n";
+	for (size_t i = 0; i < run.frameMs.size(); i++) {
+		out << i << "," << (i < run.cpuMs.size() ? run.cpuMs[i] : 0.0) << "," << (i < run.gpuMs.size() ? run.gpuMs[i] : 0.0)
+			<< "," << run.frameMs[i] << "\n";
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+/*
+* Per frame timings from a benchmark run and the summary that gets reported. Percentiles are taken from
+* the sorted samples (nearest rank), so p99 over 1000 frames is the 10th worst frame.
+*/
+
+struct TimingSummary {
+	double mean = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+	double worst = 0.0;
+	int worstFrame = -1; // index of the worst sample
+};
+
+TimingSummary Summarize(const std::vector<double>& samples);
+
+// one benchmark run of one scene
+struct FrameTimings {
+	std::string scene;
+	double timestep = 0.0; // simulated seconds per frame
+	std::vector<double> cpuMs; // submission, from frame start until the draws are issued
+	std::vector<double> gpuMs; // GL_TIME_ELAPSED around the draws
+	std::vector<double> frameMs; // wall time of the whole frame, swap included
+	long long triangles = 0; // per frame, from the last frame
+	int drawCalls = 0;
+};
+
+// a JSON array with one object per run: scene, frame count, and a summary for cpu, gpu and frame times
+void WriteTimingsJson(std::ostream& out, const std::vector<FrameTimings>& runs);
+
+// every frame of one run as CSV: frame, cpu, gpu and frame ms
+void WriteFrameTimesCsv(std::ostream& out, const FrameTimings& run);
+
+#endif
@@ -0,0 +1,153 @@
+#include "geometryCache.h"
+#include "hash.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cstddef> // offsetof
+
+std::string GeometryCache::KeyFor(const OpenGLMesh& mesh, bool packed) {
+
+	if (packed && CanPackVertices(mesh)) return KeyFor(mesh) + " packed";
+	if (mesh.geometryKey != "") return mesh.geometryKey;
+
+	uint64_t hash = FNV_OFFSET_BASIS;
+	GLuint layout[4] = { mesh.floatsPerVertex, mesh.floatsPerColor, mesh.floatsPerUV, mesh.floatsPerNormal };
+	hashBytes(hash, layout, sizeof(layout));
+	hashBytes(hash, mesh.vertices.data(), sizeof(GLfloat) * mesh.vertices.size());
+	hashBytes(hash, mesh.indices.data(), mesh.indices.byteSize());
+
+	// sizes are part of the key too, so a collision would also need matching lengths
+	char key[64];
+	snprintf(key, sizeof(key), "hash %016llx %zu %zu", (unsigned long long)hash, mesh.vertices.size(), mesh.indices.size());
+	return key;
+}
+
+GeometryBuffers* GeometryCache::Acquire(OpenGLMesh& mesh, bool packed) {
+
+	requests++;
+	packed = packed && CanPackVertices(mesh);
+	std::string key = KeyFor(mesh, packed);
+
+	auto found = mGeometry.find(key);
+	if (found != mGeometry.end()) {
+		found->second.refCount++;
+		bytesSaved += found->second.byteSize;
+		return &found->second;
+	}
+
+	GeometryBuffers& geometry = mGeometry[key];
+	geometry.key = key;
+	geometry.refCount = 1;
+	Upload(mesh, geometry, packed);
+
+	uploads++;
+	bytesUploaded += geometry.byteSize;
+	return &geometry;
+}
+
+void GeometryCache::Release(GeometryBuffers* geometry) {
+
+	if (geometry == nullptr) return;
+	if (--geometry->refCount > 0) return;
+
+	glDeleteVertexArrays(1, &geometry->vao);
+	GLuint buffers[2] = { geometry->vbo, geometry->ibo };
+	glDeleteBuffers(2, buffers);
+	mGeometry.erase(geometry->key); // geometry is dangling after this
+}
+
+void GeometryCache::Upload(OpenGLMesh& mesh, GeometryBuffers& geometry, bool packed) {
+
+	// packed meshes go up in their compact layout instead of the floats
+	PackedMesh packedMesh;
+	if (packed) {
+		PackingAccuracy accuracy;
+		packedMesh = PackVertices(mesh, &accuracy);
+		GLuint floatBytes = sizeof(GLfloat) * (mesh.floatsPerVertex + mesh.floatsPerColor + mesh.floatsPerUV + mesh.floatsPerNormal);
+		std::cout << "INFO: Packed \"" << geometry.key << "\": " << floatBytes << " -> " << sizeof(PackedVertex)
+			<< " bytes a vertex, largest errors: position " << accuracy.positionError << ", uv " << accuracy.uvError
+			<< ", normal " << accuracy.normalErrorDegrees << " degrees" << std::endl;
+	}
+	geometry.packed = packed;
+	geometry.decode = packedMesh.decode();
+
+	//determine the byte size of the data in mesh vectors (for GPU buffer)
+	auto vertByteSize = packed ? sizeof(PackedVertex) * packedMesh.vertices.size() : sizeof(GLfloat) * mesh.vertices.size();
+	auto indexByteSize = mesh.indices.byteSize(); // 1, 2 or 4 bytes each, see MeshIndices
+	const void* vertexData = packed ? (const void*)packedMesh.vertices.data() : (const void*)mesh.vertices.data();
+
+	// direct state access: buffers and VAO are created and filled by name, nothing gets bound
+	glCreateBuffers(1, &geometry.vbo);
+	glCreateBuffers(1, &geometry.ibo);
+	glNamedBufferStorage(geometry.vbo, vertByteSize, vertexData, 0); // immutable, never written again
+	glNamedBufferStorage(geometry.ibo, indexByteSize, mesh.indices.data(), 0);
+
+	glCreateVertexArrays(1, &geometry.vao);
+	if (packed) SetPackedVertexAttributes(geometry.vao, geometry.vbo);
+	else SetVertexAttributes(geometry.vao, mesh, geometry.vbo);
+	glVertexArrayElementBuffer(geometry.vao, geometry.ibo);
+
+	geometry.nIndices = mesh.nIndices();
+	geometry.indexType = mesh.indices.getType();
+	geometry.byteSize = vertByteSize + indexByteSize;
+}
+
+void GeometryCache::SetVertexAttributes(GLuint vao, const OpenGLMesh& mesh, GLuint vbo) {
+
+	// ---- Create the Vertex Attribute Pointers ----
+	// (these are referenced by the shaders)
+
+	//size in memory between each point/color combo defines stride
+	GLint stride = sizeof(float) * (mesh.floatsPerVertex + mesh.floatsPerColor + mesh.floatsPerUV + mesh.floatsPerNormal);
+
+	// all per vertex attributes read the one interleaved buffer on binding 0
+	glVertexArrayVertexBuffer(vao, VERTEX_BINDING, vbo, 0, stride);
+
+	// location 0 starts at 0 and picks floatspervertex = 3 values each
+	EnableAttribute(vao, 0, mesh.floatsPerVertex, 0);
+
+	// location 1 starts after floatsperindex=3 (times memory size) and picks floatspercolor=4 values each
+	// (spheres and cylinders have no color, and a 0 size attribute is a GL error)
+	if (mesh.floatsPerColor > 0)
+		EnableAttribute(vao, 1, mesh.floatsPerColor, sizeof(float) * mesh.floatsPerVertex);
+
+	// location 2 makes texture coordinates from this mesh available to shader
+	if (mesh.floatsPerUV > 0)
+		EnableAttribute(vao, 2, mesh.floatsPerUV, sizeof(float) * (mesh.floatsPerVertex + mesh.floatsPerColor));
+
+	// location 3 will hold model normals
+	if (mesh.floatsPerNormal > 0)
+		EnableAttribute(vao, 3, mesh.floatsPerNormal, sizeof(float) * (mesh.floatsPerVertex + mesh.floatsPerColor + mesh.floatsPerUV));
+}
+
+void GeometryCache::SetPackedVertexAttributes(GLuint vao, GLuint vbo) {
+
+	glVertexArrayVertexBuffer(vao, VERTEX_BINDING, vbo, 0, sizeof(PackedVertex));
+
+	// same locations as the float layout. Normalized, so the shader reads 0..1 positions and -1..1 normals
+	glVertexArrayAttribFormat(vao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, position));
+	glVertexArrayAttribFormat(vao, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, uv));
+	glVertexArrayAttribFormat(vao, 3, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, normal));
+	for (GLuint location : { 0u, 2u, 3u }) {
+		glVertexArrayAttribBinding(vao, location, VERTEX_BINDING);
+		glEnableVertexArrayAttrib(vao, location);
+	}
+}
+
+void GeometryCache::EnableAttribute(GLuint vao, GLuint location, GLint size, GLuint offset, GLuint binding) {
+	glVertexArrayAttribFormat(vao, location, size, GL_FLOAT, GL_FALSE, offset);
+	glVertexArrayAttribBinding(vao, location, binding);
+	glEnableVertexArrayAttrib(vao, location);
+}
+
+GLsizeiptr GeometryCache::getResidentBytes() const {
+	GLsizeiptr bytes = 0;
+	for (auto& geometry : mGeometry) bytes += geometry.second.byteSize;
+	return bytes;
+}
+
+void GeometryCache::printStats() {
+
+	std::cout << "INFO: Geometry cache: " << requests << " shapes, " << uploads << " unique uploads, "
+		<< bytesUploaded / 1024 << " KB on GPU, " << bytesSaved / 1024 << " KB of duplicate uploads skipped" << std::endl;
+}
@@ -0,0 +1,78 @@
+#ifndef GEOMETRYCACHE_H
+#define GEOMETRYCACHE_H
+
+#include <GL\glew.h>
+
+#include "openGLmesh.h"
+#include "vertexPacking.h"
+
+#include <string>
+#include <unordered_map>
+
+/*
+* Registry of geometry that is already on the GPU. Meshes are identified by the key the shapes namespace
+* stamps on them (shape type + tessellation, e.g. "sphere 32 32"), or by a hash of their contents when they
+* were built by hand. Every mesh with the same key shares one VBO/IBO pair and one VAO.
+*
+* Entries are reference counted, the buffers are deleted when the last mesh using them is released.
+* So GPU memory and upload time grow with the number of unique shapes, not the number of objects.
+*/
+
+// GPU side of one unique geometry
+struct GeometryBuffers {
+	GLuint vao; // vertex layout for the regular render path
+	GLuint vbo;
+	GLuint ibo;
+	GLuint nIndices;
+	GLenum indexType; // GL_UNSIGNED_BYTE / SHORT / INT, whatever the mesh needed
+	bool packed; // PackedVertex layout, decode takes its positions back to model space
+	glm::mat4 decode;
+	GLsizeiptr byteSize; // vertex + index bytes on the GPU
+	int refCount;
+	std::string key;
+};
+
+class GeometryCache {
+
+	public:
+
+		// returns the shared buffers for this mesh, uploading them only the first time the key is seen.
+		// packed uploads textured meshes in the PackedVertex layout (others stay as they are)
+		GeometryBuffers* Acquire(OpenGLMesh& mesh, bool packed = false);
+		void Release(GeometryBuffers* geometry);
+		bool Contains(const std::string& key) const { return mGeometry.count(key) > 0; }
+
+		// per vertex data always comes from this binding, others (instancing) can use the ones after it
+		static const GLuint VERTEX_BINDING = 0;
+
+		// describe the interleaved layout of a mesh to a VAO, reading from vbo on VERTEX_BINDING (DSA, binds nothing)
+		static void SetVertexAttributes(GLuint vao, const OpenGLMesh& mesh, GLuint vbo);
+
+		// the PackedVertex layout on the same locations: normalized shorts, half floats, octahedral normal
+		static void SetPackedVertexAttributes(GLuint vao, GLuint vbo);
+
+		// float attribute at a byte offset into the vertex of a buffer binding
+		static void EnableAttribute(GLuint vao, GLuint location, GLint size, GLuint offset, GLuint binding = VERTEX_BINDING);
+
+		// shape key if the mesh has one, otherwise a hash of layout, vertices and indices (+ " packed" when it would be)
+		static std::string KeyFor(const OpenGLMesh& mesh, bool packed = false);
+
+		// vertex + index bytes of the geometry currently on the GPU
+		GLsizeiptr getResidentBytes() const;
+
+		void printStats();
+
+	private:
+
+		void Upload(OpenGLMesh& mesh, GeometryBuffers& geometry, bool packed);
+
+		std::unordered_map<std::string, GeometryBuffers> mGeometry; // element pointers stay valid across inserts
+
+		// counters for the startup report
+		int requests = 0;
+		int uploads = 0;
+		GLsizeiptr bytesUploaded = 0;
+		GLsizeiptr bytesSaved = 0;
+};
+
+#endif
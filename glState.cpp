@@ -0,0 +1,88 @@
+#include "glState.h"
+
+#include <iostream>
+
+bool GLStateCache::UseProgram(GLuint program) {
+	if (!Track(this->program != program)) return false;
+	glUseProgram(program);
+	this->program = program;
+	return true;
+}
+
+bool GLStateCache::BindTexture(GLuint unit, GLuint texture) {
+	if (unit >= MAX_TEXTURE_UNITS) { // not tracked, always pass through
+		glBindTextureUnit(unit, texture);
+		return Track(true);
+	}
+	if (!Track(textures[unit] != texture)) return false;
+	glBindTextureUnit(unit, texture);
+	textures[unit] = texture;
+	return true;
+}
+
+bool GLStateCache::BindVertexArray(GLuint vao) {
+	if (!Track(this->vao != vao)) return false;
+	glBindVertexArray(vao);
+	this->vao = vao;
+	return true;
+}
+
+bool GLStateCache::BindIndirectBuffer(GLuint buffer) {
+	if (!Track(indirectBuffer != buffer)) return false;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+	indirectBuffer = buffer;
+	return true;
+}
+
+int GLStateCache::CapabilitySlot(GLenum capability) {
+	switch (capability) {
+		case GL_DEPTH_TEST: return 0;
+		case GL_CULL_FACE: return 1;
+		case GL_BLEND: return 2;
+		case GL_SCISSOR_TEST: return 3;
+		default: return -1;
+	}
+}
+
+bool GLStateCache::Enable(GLenum capability) {
+	int slot = CapabilitySlot(capability);
+	if (slot < 0) { glEnable(capability); return Track(true); }
+	if (!Track(capabilities[slot] != 1)) return false;
+	glEnable(capability);
+	capabilities[slot] = 1;
+	return true;
+}
+
+bool GLStateCache::Disable(GLenum capability) {
+	int slot = CapabilitySlot(capability);
+	if (slot < 0) { glDisable(capability); return Track(true); }
+	if (!Track(capabilities[slot] != 0)) return false;
+	glDisable(capability);
+	capabilities[slot] = 0;
+	return true;
+}
+
+void GLStateCache::Invalidate() {
+	program = UNKNOWN;
+	vao = UNKNOWN;
+	indirectBuffer = UNKNOWN;
+	for (auto& texture : textures) texture = UNKNOWN;
+	for (auto& capability : capabilities) capability = -1;
+}
+
+void GLStateCache::BeginFrame() {
+	totalIssued += issuedCalls;
+	totalSkipped += skippedCalls;
+	frames++;
+	issuedCalls = 0;
+	skippedCalls = 0;
+}
+
+void GLStateCache::printStats() {
+
+	if (frames == 0) return;
+	double issued = (double)totalIssued / frames;
+	double skipped = (double)totalSkipped / frames;
+	std::cout << "INFO: GL state cache: " << issued << " state calls per frame issued, " << skipped
+		<< " redundant calls per frame skipped over " << frames << " frames" << std::endl;
+}
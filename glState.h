@@ -0,0 +1,63 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <GL\glew.h>
+
+/*
+* Shadow copy of the bits of GL state the render loop changes. Every call goes through here, and if the
+* value is already set the GL call is dropped. That includes state carried over from the previous frame,
+* so nothing gets unbound at the end of a frame just to be bound again at the start of the next one.
+*
+* This only works if nobody else binds behind its back. Resource creation uses direct state access
+* (glCreate*, glNamed*, glTexture*) for exactly that reason. Anything that has to bind anyway should
+* call Invalidate afterwards.
+*/
+class GLStateCache {
+
+	public:
+
+		static const int MAX_TEXTURE_UNITS = 8;
+
+		// each returns true if the GL call was actually made
+		bool UseProgram(GLuint program);
+		bool BindTexture(GLuint unit, GLuint texture); // glBindTextureUnit, no active texture juggling
+		bool BindVertexArray(GLuint vao);
+		bool BindIndirectBuffer(GLuint buffer); // GL_DRAW_INDIRECT_BUFFER, read by the multi-draw path
+		bool Enable(GLenum capability);
+		bool Disable(GLenum capability);
+
+		// forget everything, the next call of each kind goes through
+		void Invalidate();
+
+		// per frame counters, the previous frame is added to the running totals
+		void BeginFrame();
+		int getIssuedCalls() const { return issuedCalls; }
+		int getSkippedCalls() const { return skippedCalls; }
+
+		// average issued and skipped calls per frame so far
+		void printStats();
+
+	private:
+
+		static const GLuint UNKNOWN = ~0u;
+
+		bool Track(bool changed) { if (changed) issuedCalls++; else skippedCalls++; return changed; }
+		int CapabilitySlot(GLenum capability);
+
+		GLuint program = UNKNOWN;
+		GLuint vao = UNKNOWN;
+		GLuint indirectBuffer = UNKNOWN;
+		GLuint textures[MAX_TEXTURE_UNITS] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+
+		// only the few capabilities we toggle are tracked: 0 = off, 1 = on, -1 = unknown
+		static const int NUM_CAPABILITIES = 4;
+		int capabilities[NUM_CAPABILITIES] = { -1, -1, -1, -1 };
+
+		int issuedCalls = 0;
+		int skippedCalls = 0;
+		long long totalIssued = 0;
+		long long totalSkipped = 0;
+		long long frames = 0;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "hud.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef> // offsetof
+
+// 5x7 font for ASCII 32..126 in 8 pixel cells, five columns per glyph, bit 0 = top row. 127 is a solid block
+static const unsigned char FONT[96][5] = {
+	{0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14}, //  !"#
+	{0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x56,0x20,0x50}, {0x00,0x08,0x07,0x03,0x00}, // $%&'
+	{0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08}, // ()*+
+	{0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x00,0x60,0x60,0x00}, {0x20,0x10,0x08,0x04,0x02}, // ,-./
+	{0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x72,0x49,0x49,0x49,0x46}, {0x21,0x41,0x49,0x4D,0x33}, // 0123
+	{0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x31}, {0x41,0x21,0x11,0x09,0x07}, // 4567
+	{0x36,0x49,0x49,0x49,0x36}, {0x46,0x49,0x49,0x29,0x1E}, {0x00,0x00,0x14,0x00,0x00}, {0x00,0x40,0x34,0x00,0x00}, // 89:;
+	{0x00,0x08,0x14,0x22,0x41}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x59,0x09,0x06}, // <=>?
+	{0x3E,0x41,0x5D,0x59,0x4E}, {0x7C,0x12,0x11,0x12,0x7C}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22}, // @ABC
+	{0x7F,0x41,0x41,0x41,0x3E}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x41,0x51,0x73}, // DEFG
+	{0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41}, // HIJK
+	{0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x1C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E}, // LMNO
+	{0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x26,0x49,0x49,0x49,0x32}, // PQRS
+	{0x03,0x01,0x7F,0x01,0x03}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F}, // TUVW
+	{0x63,0x14,0x08,0x14,0x63}, {0x03,0x04,0x78,0x04,0x03}, {0x61,0x59,0x49,0x4D,0x43}, {0x00,0x7F,0x41,0x41,0x41}, // XYZ[
+	{0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x41,0x7F}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40}, // \]^_
+	{0x00,0x03,0x07,0x08,0x00}, {0x20,0x54,0x54,0x78,0x40}, {0x7F,0x28,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x28}, // `abc
+	{0x38,0x44,0x44,0x28,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x00,0x08,0x7E,0x09,0x02}, {0x0C,0x52,0x52,0x52,0x3E}, // defg
+	{0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x44,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00}, // hijk
+	{0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x78,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38}, // lmno
+	{0x7C,0x14,0x14,0x14,0x08}, {0x08,0x14,0x14,0x18,0x7C}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x24}, // pqrs
+	{0x04,0x04,0x3F,0x44,0x24}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C}, // tuvw
+	{0x44,0x28,0x10,0x28,0x44}, {0x0C,0x50,0x50,0x50,0x3C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00}, // xyz{
+	{0x00,0x00,0x77,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x02,0x01,0x02,0x04,0x02}, {0xFF,0xFF,0xFF,0xFF,0xFF}, // |}~ solid
+};
+
+void Hud::Initialize(GLuint program, const UniformTable& uniforms) {
+
+	this->program = program;
+	screenSize = uniforms.get<glm::vec2>("screenSize");
+
+	// expand the font into the atlas, one 6x8 cell per character (the sixth column is the spacing)
+	const int atlasWidth = ATLAS_COLUMNS * GLYPH_CELL_WIDTH;
+	const int atlasHeight = ATLAS_ROWS * GLYPH_CELL_HEIGHT;
+	std::vector<unsigned char> pixels(atlasWidth * atlasHeight, 0);
+	for (int glyph = 0; glyph < 96; glyph++) {
+		int cellX = (glyph % ATLAS_COLUMNS) * GLYPH_CELL_WIDTH;
+		int cellY = (glyph / ATLAS_COLUMNS) * GLYPH_CELL_HEIGHT;
+		for (int column = 0; column < GLYPH_WIDTH; column++) {
+			for (int row = 0; row < GLYPH_CELL_HEIGHT; row++) {
+				if (FONT[glyph][column] & (1 << row)) pixels[(cellY + row) * atlasWidth + cellX + column] = 255;
+			}
+		}
+	}
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &atlas);
+	glTextureStorage2D(atlas, 1, GL_R8, atlasWidth, atlasHeight);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(atlas, 0, 0, 0, atlasWidth, atlasHeight, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+	glTextureParameteri(atlas, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(atlas, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// position, uv, color (bytes, normalized) interleaved in one stream buffer
+	glCreateBuffers(1, &vbo);
+	glCreateVertexArrays(1, &vao);
+	glVertexArrayVertexBuffer(vao, 0, vbo, 0, sizeof(Vertex));
+	glVertexArrayAttribFormat(vao, 0, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, x));
+	glVertexArrayAttribFormat(vao, 1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, u));
+	glVertexArrayAttribFormat(vao, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, color));
+	for (GLuint location = 0; location < 3; location++) {
+		glVertexArrayAttribBinding(vao, location, 0);
+		glEnableVertexArrayAttrib(vao, location);
+	}
+
+	// the only blending in the renderer, so the function is set once
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void Hud::AddFrame(float frameMs, float cpuMs, float gpuMs) {
+	mHistory[0][next] = frameMs;
+	mHistory[1][next] = cpuMs;
+	mHistory[2][next] = gpuMs;
+	next = (next + 1) % HISTORY;
+	samples = std::min(samples + 1, HISTORY);
+}
+
+float Hud::Average(int series) const {
+	if (samples == 0) return 0.0f;
+	float sum = 0.0f;
+	for (int i = 0; i < samples; i++) sum += mHistory[series][(next + HISTORY - 1 - i) % HISTORY];
+	return sum / samples;
+}
+
+float Hud::Deviation(int series) const {
+	if (samples < 2) return 0.0f;
+	float mean = Average(series);
+	float sum = 0.0f;
+	for (int i = 0; i < samples; i++) {
+		float difference = mHistory[series][(next + HISTORY - 1 - i) % HISTORY] - mean;
+		sum += difference * difference;
+	}
+	return std::sqrt(sum / (samples - 1));
+}
+
+void Hud::Begin(int width, int height) {
+	this->width = width;
+	this->height = height;
+	mVertices.clear();
+}
+
+void Hud::Quad(float x, float y, float w, float h, float u0, float v0, float u1, float v1, uint32_t color) {
+
+	// two triangles, no index buffer
+	Vertex topLeft = { x, y, u0, v0, color };
+	Vertex topRight = { x + w, y, u1, v0, color };
+	Vertex bottomLeft = { x, y + h, u0, v1, color };
+	Vertex bottomRight = { x + w, y + h, u1, v1, color };
+	mVertices.insert(mVertices.end(), { topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight });
+}
+
+void Hud::Rect(float x, float y, float w, float h, uint32_t color) {
+
+	// sample the middle of the solid glyph, every texel there is full coverage
+	int glyph = SOLID_GLYPH - 32;
+	float u = ((glyph % ATLAS_COLUMNS) * GLYPH_CELL_WIDTH + GLYPH_WIDTH * 0.5f) / (ATLAS_COLUMNS * GLYPH_CELL_WIDTH);
+	float v = ((glyph / ATLAS_COLUMNS) * GLYPH_CELL_HEIGHT + GLYPH_CELL_HEIGHT * 0.5f) / (ATLAS_ROWS * GLYPH_CELL_HEIGHT);
+	Quad(x, y, w, h, u, v, u, v, color);
+}
+
+void Hud::Text(float x, float y, const std::string& text, uint32_t color, float scale) {
+
+	const float atlasWidth = ATLAS_COLUMNS * GLYPH_CELL_WIDTH;
+	const float atlasHeight = ATLAS_ROWS * GLYPH_CELL_HEIGHT;
+
+	for (char character : text) {
+		int glyph = (unsigned char)character - 32;
+		if (glyph > 0 && glyph < 96) { // spaces and anything unprintable only advance
+			float u0 = (glyph % ATLAS_COLUMNS) * GLYPH_CELL_WIDTH / atlasWidth;
+			float v0 = (glyph / ATLAS_COLUMNS) * GLYPH_CELL_HEIGHT / atlasHeight;
+			Quad(x, y, GLYPH_WIDTH * scale, GLYPH_CELL_HEIGHT * scale,
+				u0, v0, u0 + GLYPH_WIDTH / atlasWidth, v0 + GLYPH_CELL_HEIGHT / atlasHeight, color);
+		}
+		x += GLYPH_CELL_WIDTH * scale;
+	}
+}
+
+void Hud::Graph(float x, float y, float w, float h, int series, float maxValue, uint32_t color) {
+
+	// background, then one bar per frame, oldest on the left
+	Rect(x, y, w, h, Color(0, 0, 0, 140));
+	float barWidth = w / HISTORY;
+	for (int i = 0; i < samples; i++) {
+		float value = mHistory[series][(next + HISTORY - samples + i) % HISTORY];
+		float barHeight = std::min(value / maxValue, 1.0f) * h;
+		Rect(x + (HISTORY - samples + i) * barWidth, y + h - barHeight, std::max(barWidth - 1.0f, 1.0f), barHeight, color);
+	}
+}
+
+void Hud::Draw(GLStateCache& state) {
+
+	if (mVertices.empty()) return;
+
+	// orphan and refill: the driver hands out fresh memory instead of waiting for last frame's draw
+	GLsizeiptr size = sizeof(Vertex) * mVertices.size();
+	if (size > vboCapacity) vboCapacity = std::max(size, vboCapacity * 2);
+	glNamedBufferData(vbo, vboCapacity, NULL, GL_STREAM_DRAW);
+	glNamedBufferSubData(vbo, 0, size, mVertices.data());
+
+	state.Disable(GL_DEPTH_TEST);
+	state.Enable(GL_BLEND);
+	state.UseProgram(program);
+	screenSize.set(glm::vec2((float)width, (float)height));
+	state.BindTexture(0, atlas);
+	state.BindVertexArray(vao);
+
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)mVertices.size());
+}
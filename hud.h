@@ -0,0 +1,89 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <GL\glew.h>
+
+#include "uniforms.h"
+#include "glState.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+* Performance overlay. Text and graphs are collected as screen space quads into one vertex array during the
+* frame and drawn with a single glDrawArrays at the end, all sampling one small font atlas.
+*
+* The atlas is a built in 5x7 pixel font (8 pixel cells) (printable ASCII) in a 96x48 single channel texture. Character 127
+* is a solid block, which is what plain rectangles and graph bars sample, so they need no second texture
+* or shader.
+*
+* Coordinates are in pixels from the top left of the framebuffer. Colors are packed RGBA, see Color().
+*/
+class Hud {
+
+	public:
+
+		static const int HISTORY = 120; // frames kept for the graphs
+
+		static uint32_t Color(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+			return r | (g << 8) | (b << 16) | ((uint32_t)a << 24);
+		}
+
+		// atlas, buffers and uniform handles. The program is built by the controller from the hud shaders
+		void Initialize(GLuint program, const UniformTable& uniforms);
+
+		// once per frame, before any drawing, for the graphs
+		void AddFrame(float frameMs, float cpuMs, float gpuMs);
+
+		// start collecting quads for a framebuffer of this size
+		void Begin(int width, int height);
+
+		void Rect(float x, float y, float w, float h, uint32_t color);
+		void Text(float x, float y, const std::string& text, uint32_t color, float scale = 2.0f); // one line, no wrapping
+		void Graph(float x, float y, float w, float h, int series, float maxValue, uint32_t color); // 0 frame, 1 cpu, 2 gpu
+
+		// newest sample of a series, and the mean and standard deviation over the history
+		float Latest(int series) const { return mHistory[series][(next + HISTORY - 1) % HISTORY]; }
+		float Average(int series) const;
+		float Deviation(int series) const;
+
+		// everything collected since Begin, in one draw call
+		void Draw(GLStateCache& state);
+
+		float getLineHeight(float scale = 2.0f) const { return GLYPH_CELL_HEIGHT * scale + 2.0f; }
+
+	private:
+
+		static const int GLYPH_WIDTH = 5;
+		static const int GLYPH_CELL_WIDTH = 6;
+		static const int GLYPH_CELL_HEIGHT = 8;
+		static const int ATLAS_COLUMNS = 16;
+		static const int ATLAS_ROWS = 6;
+		static const int SOLID_GLYPH = 127;
+
+		struct Vertex {
+			float x, y;
+			float u, v;
+			uint32_t color;
+		};
+
+		void Quad(float x, float y, float w, float h, float u0, float v0, float u1, float v1, uint32_t color);
+
+		GLuint program = 0;
+		Uniform<glm::vec2> screenSize;
+		GLuint atlas = 0;
+		GLuint vao = 0;
+		GLuint vbo = 0;
+		GLsizeiptr vboCapacity = 0;
+
+		int width = 0;
+		int height = 0;
+		std::vector<Vertex> mVertices;
+
+		float mHistory[3][HISTORY] = {};
+		int next = 0; // where the next sample goes
+		int samples = 0;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#include "inputQueue.h"
+
+bool InputQueue::Push(const InputEvent& event) {
+
+	size_t write = head.load(std::memory_order_relaxed);
+	if (write - tail.load(std::memory_order_acquire) == CAPACITY) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	mEvents[write & (CAPACITY - 1)] = event;
+	head.store(write + 1, std::memory_order_release); // publishes the event
+	return true;
+}
+
+bool InputQueue::Pop(InputEvent& event) {
+
+	size_t read = tail.load(std::memory_order_relaxed);
+	if (read == head.load(std::memory_order_acquire)) return false;
+
+	event = mEvents[read & (CAPACITY - 1)];
+	tail.store(read + 1, std::memory_order_release); // hands the slot back to the producer
+	return true;
+}
@@ -0,0 +1,57 @@
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+enum class InputEventType : int {
+	CURSOR, // x, y = cursor position in screen coordinates
+	SCROLL, // y = wheel offset
+	KEY, // key, action, mods as GLFW reports them
+	RESIZE, // x, y = new framebuffer size
+	REFRESH, // window contents were lost
+};
+
+// one input event, stamped with glfwGetTime when the callback saw it
+struct InputEvent {
+	InputEventType type;
+	double time;
+	float x;
+	float y;
+	int key;
+	int action;
+	int mods;
+};
+
+/*
+* Single producer, single consumer ring of input events. The GLFW callbacks push, the controller pops, and neither
+* side ever locks: each index is only written by its own side and published with a release store, so the other
+* side's acquire load sees the event contents complete. That holds whichever thread the callbacks run on.
+*
+* Full, new events are dropped (and counted) rather than overwriting ones the consumer has not seen.
+*/
+class InputQueue {
+
+	public:
+
+		static const size_t CAPACITY = 4096; // power of two
+
+		// producer side
+		bool Push(const InputEvent& event);
+
+		// consumer side, false when empty
+		bool Pop(InputEvent& event);
+
+		size_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+	private:
+
+		InputEvent mEvents[CAPACITY];
+
+		// free running counters, masked on use. Kept on separate cache lines so the two sides do not share one
+		alignas(64) std::atomic<size_t> head{ 0 }; // next to write, producer owned
+		alignas(64) std::atomic<size_t> tail{ 0 }; // next to read, consumer owned
+		std::atomic<size_t> dropped{ 0 };
+};
+
+#endif
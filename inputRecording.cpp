@@ -0,0 +1,166 @@
+#include "inputRecording.h"
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+
+static const char MAGIC[4] = { 'C', 'S', 'I', 'R' };
+static const uint32_t VERSION = 2;
+
+template <typename T>
+static void Write(std::ostream& out, const T& value) {
+	out.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static T Read(std::istream& in) {
+	T value;
+	if (!in.read((char*)&value, sizeof(T))) throw std::runtime_error("Input recording is truncated");
+	return value;
+}
+
+void InputRecording::Begin(double origin) {
+	this->origin = origin;
+	frames.clear();
+	pending.clear();
+}
+
+static bool IsUserInput(const InputEvent& event) {
+	return event.type == InputEventType::CURSOR || event.type == InputEventType::SCROLL || event.type == InputEventType::KEY;
+}
+
+void InputRecording::AddEvent(const InputEvent& event) {
+	if (!IsUserInput(event)) return;
+	pending.push_back(event);
+	pending.back().time -= origin;
+}
+
+void InputRecording::EndFrame(double elapsed) {
+	frames.push_back({ elapsed, std::move(pending), {} });
+	pending.clear();
+}
+
+void InputRecording::AddLatchedEvent(const InputEvent& event) {
+	if (frames.empty()) return AddEvent(event); // nothing drawn yet
+	if (!IsUserInput(event)) return;
+	frames.back().latched.push_back(event);
+	frames.back().latched.back().time -= origin;
+}
+
+size_t InputRecording::getEventCount() const {
+	size_t count = 0;
+	for (auto& frame : frames) count += frame.events.size() + frame.latched.size();
+	return count;
+}
+
+// count, then each event as its type and only the fields that type uses
+static void WriteEvents(std::ostream& out, const std::vector<InputEvent>& events) {
+	Write(out, (uint32_t)events.size());
+	for (auto& event : events) {
+		Write(out, (uint8_t)event.type);
+		Write(out, (float)event.time);
+		switch (event.type) {
+			case InputEventType::CURSOR:
+				Write(out, event.x);
+				Write(out, event.y);
+				break;
+			case InputEventType::SCROLL:
+				Write(out, event.y);
+				break;
+			default:
+				Write(out, (int16_t)event.key);
+				Write(out, (uint8_t)event.action);
+				Write(out, (uint8_t)event.mods);
+				break;
+		}
+	}
+}
+
+static void ReadEvents(std::istream& in, std::vector<InputEvent>& events, const std::string& path) {
+	events.resize(Read<uint32_t>(in));
+	for (auto& event : events) {
+		event = {};
+		event.type = (InputEventType)Read<uint8_t>(in);
+		event.time = Read<float>(in);
+		switch (event.type) {
+			case InputEventType::CURSOR:
+				event.x = Read<float>(in);
+				event.y = Read<float>(in);
+				break;
+			case InputEventType::SCROLL:
+				event.y = Read<float>(in);
+				break;
+			case InputEventType::KEY:
+				event.key = Read<int16_t>(in);
+				event.action = Read<uint8_t>(in);
+				event.mods = Read<uint8_t>(in);
+				break;
+			default:
+				throw std::runtime_error(path + " has an unknown event type");
+		}
+	}
+}
+
+void InputRecording::Save(const std::string& path) const {
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) throw std::runtime_error("Could not write input recording " + path);
+
+	out.write(MAGIC, sizeof(MAGIC));
+	Write(out, VERSION);
+	Write(out, start.cameraPosition);
+	Write(out, start.cameraPointsAt);
+	Write(out, start.rotationX);
+	Write(out, start.rotationY);
+	Write(out, start.panSpeed);
+	Write(out, start.rotateSpeed);
+	Write(out, start.fieldOfView);
+	Write(out, (uint8_t)start.cursorSeen);
+	Write(out, start.cursorX);
+	Write(out, start.cursorY);
+	Write(out, (uint8_t)start.orthographic);
+	Write(out, (uint16_t)start.keysDown.size());
+	for (int key : start.keysDown) Write(out, (int16_t)key);
+
+	// per frame: elapsed, the events before the steps, the latched ones after them
+	Write(out, (uint32_t)frames.size());
+	for (auto& frame : frames) {
+		Write(out, frame.elapsed);
+		WriteEvents(out, frame.events);
+		WriteEvents(out, frame.latched);
+	}
+	if (!out) throw std::runtime_error("Could not write input recording " + path);
+}
+
+void InputRecording::Load(const std::string& path) {
+
+	std::ifstream in(path, std::ios::binary);
+	if (!in) throw std::runtime_error("Could not open input recording " + path);
+
+	char magic[4] = {};
+	in.read(magic, sizeof(magic));
+	if (!in || std::string(magic, 4) != std::string(MAGIC, 4)) throw std::runtime_error(path + " is not an input recording");
+	if (Read<uint32_t>(in) != VERSION) throw std::runtime_error(path + " was recorded by a different version");
+
+	start.cameraPosition = Read<glm::vec3>(in);
+	start.cameraPointsAt = Read<glm::vec3>(in);
+	start.rotationX = Read<float>(in);
+	start.rotationY = Read<float>(in);
+	start.panSpeed = Read<float>(in);
+	start.rotateSpeed = Read<float>(in);
+	start.fieldOfView = Read<float>(in);
+	start.cursorSeen = Read<uint8_t>(in) != 0;
+	start.cursorX = Read<float>(in);
+	start.cursorY = Read<float>(in);
+	start.orthographic = Read<uint8_t>(in) != 0;
+	start.keysDown.resize(Read<uint16_t>(in));
+	for (int& key : start.keysDown) key = Read<int16_t>(in);
+
+	frames.resize(Read<uint32_t>(in));
+	for (auto& frame : frames) {
+		frame.elapsed = Read<double>(in);
+		ReadEvents(in, frame.events, path);
+		ReadEvents(in, frame.latched, path);
+	}
+	pending.clear();
+}
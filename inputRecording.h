@@ -0,0 +1,68 @@
+#ifndef INPUTRECORDING_H
+#define INPUTRECORDING_H
+
+#include <glm/glm.hpp>
+
+#include "inputQueue.h"
+
+#include <string>
+#include <vector>
+
+/*
+* A captured input session, for replaying exactly what a user did. Every frame RunScene rendered is kept with the
+* events drained before its simulation steps, the simulated time it advanced and the events the late latch drained
+* after the steps, together with the camera and input state the session started from. Replaying the frames in order
+* through the fixed timestep simulation puts the camera where it was on every frame, however fast the replay runs.
+*
+* Only user input is kept (cursor, scroll, keys), window events belong to the window they happened to. The file is
+* a small header followed by the frames, each event packed by type, little endian as the platforms we build for.
+*/
+
+// what the events are applied on top of
+struct RecordingStart {
+	glm::vec3 cameraPosition;
+	glm::vec3 cameraPointsAt;
+	float rotationX;
+	float rotationY;
+	float panSpeed;
+	float rotateSpeed;
+	float fieldOfView;
+	bool cursorSeen;
+	float cursorX;
+	float cursorY;
+	bool orthographic;
+	std::vector<int> keysDown;
+};
+
+struct RecordedFrame {
+	double elapsed; // seconds handed to the simulation
+	std::vector<InputEvent> events;
+	std::vector<InputEvent> latched; // drained by the late latch, applied after the simulation steps
+};
+
+class InputRecording {
+
+	public:
+
+		RecordingStart start = {};
+		std::vector<RecordedFrame> frames;
+
+		// recording: event times are kept relative to origin (a glfwGetTime)
+		void Begin(double origin);
+		void AddEvent(const InputEvent& event);
+		void EndFrame(double elapsed); // the events added since the last frame belong to this one
+		void AddLatchedEvent(const InputEvent& event); // to the frame ended last, which is the one being drawn
+
+		size_t getEventCount() const;
+
+		// throw std::runtime_error on IO errors and files that are not recordings
+		void Save(const std::string& path) const;
+		void Load(const std::string& path);
+
+	private:
+
+		double origin = 0.0;
+		std::vector<InputEvent> pending;
+};
+
+#endif
@@ -12,6 +12,7 @@ class Light {
 		glm::vec3 mPosition;		
 		glm::vec3 mColor;
 		float mIntensity;
+		bool mDirty = true; // any setter, cleared by the controller once the change is on screen
 		
 	public:
 
@@ -25,6 +26,7 @@ class Light {
 
 		Light* setColor(float R, float G, float B) { 
 			mColor = glm::vec3(R, G, B); 
+			mDirty = true;
 			this->R = mColor.r;
 			this->G = mColor.g;
 			this->B = mColor.b;
@@ -37,12 +39,14 @@ class Light {
 
 		Light* setIntensity(float intensity) { 
 			mIntensity = intensity; 
+			mDirty = true;
 			return this; 
 		}
 		float getIntensity() { return mIntensity; }
 
 		Light* setPosition(float X, float Y, float Z) { 
 			mPosition = glm::vec3(X, Y, Z);
+			mDirty = true;
 			this->X = mPosition.x;
 			this->Y = mPosition.y;
 			this->Z = mPosition.z;
@@ -53,6 +57,9 @@ class Light {
 		float Y;
 		float Z;
 
+		bool isDirty() { return mDirty; }
+		void clearDirty() { mDirty = false; }
+
 };
 
 #endif
@@ -1,21 +1,201 @@
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <chrono>
 
 #include "openGLcontroller.h"
 #include "shapes.h"
+#include "cameraPath.h"
+#include "frameStats.h"
+#include "inputRecording.h"
+#include "meshOptimizer.h"
+
+/*
+* 'the duck', built from nine spheres. Returned as separate parts so the scene can add them one by one
+* and the stress scene can copy them into instanced batches.
+*/
+std::vector<OpenGLMesh> DuckParts() {
+
+	std::vector<OpenGLMesh> parts;
+	const char* duckTexture = "textures/blue.png";
+	float duckShinyness = 0.25f;
 
-int main() {
+	auto body = shapes::SphereWithLods(16, 16);
+	body.setScale(0.7f, 0.5f, 0.8f);
+	body.setRotation(0, 1, 0, 0);
+	body.setTranslation(-2.0f, 1.05, -1.0f);
+	body.texture = duckTexture;
+	body.setShininess(duckShinyness);
+	parts.push_back(body);
 
-	// Init OpenGL Controller
-	OpenGL GLControl;
-	try {
-		GLControl.Initialize();
+
+	auto lWing = shapes::SphereWithLods(16, 16);
+	lWing.setScale(0.1f, 0.25f, 0.33f);
+	lWing.setRotation(0.2f, 1, 0, 0);
+	lWing.setTranslation(-2.65f, 1.05, -1.0f);
+	lWing.texture = duckTexture;
+	lWing.setShininess(duckShinyness);
+	parts.push_back(lWing);
+
+
+	auto rWing = shapes::SphereWithLods(16, 16);
+	rWing.setScale(0.1f, 0.25f, 0.33f);
+	rWing.setRotation(0.2f, 1, 0, 0);
+	rWing.setTranslation(-1.35f, 1.05, -1.0f);
+	rWing.texture = duckTexture;
+	rWing.setShininess(duckShinyness);
+	parts.push_back(rWing);
+
+
+	auto tail = shapes::SphereWithLods(32, 32);
+	tail.setScale(0.4f, 0.15f, 0.35f);
+	tail.setRotation(1.0f, 1, 0, 0);
+	tail.setTranslation(-2.0f, 1.05, -1.7f);
+	tail.texture = duckTexture;
+	tail.setShininess(duckShinyness);
+	parts.push_back(tail);
+
+
+	auto head = shapes::SphereWithLods(16, 16);
+	head.setScale(0.4f, 0.45f, 0.45f);
+	head.setRotation(0, 1, 0, 0);
+	head.setTranslation(-2.0f, 1.85f, -.75f);
+	head.texture = duckTexture;
+	head.setShininess(duckShinyness);
+	parts.push_back(head);
+
+
+	auto lips = shapes::SphereWithLods(32, 32);
+	lips.setScale(0.3f, 0.12f, 0.4f);
+	lips.setRotation(0, 1, 0, 0);
+	lips.setTranslation(-2.0f, 1.60f, -0.5f);
+	lips.texture = "textures/orange.jpg";
+	parts.push_back(lips);
+
+
+	auto lipsTop = shapes::SphereWithLods(32, 32);
+	lipsTop.setScale(0.2f, 0.18f, 0.2f);
+	lipsTop.setRotation(0, 1, 0, 0);
+	lipsTop.setTranslation(-2.0f, 1.67f, -0.4f);
+	lipsTop.texture = "textures/orange.jpg";
+	parts.push_back(lipsTop);
+
+
+	auto lEye = shapes::SphereWithLods(16, 16);
+	lEye.setScale(0.05f, 0.1f, 0.1f);
+	lEye.setRotation(0.4f, 0, 1, 0);
+	lEye.addRotation(3.14f, 1, 0, 0);
+	lEye.setTranslation(-2.3f, 1.87f, -0.5f);
+	lEye.texture = "textures/eye.png";
+	parts.push_back(lEye);
+
+	
+	auto rEye = shapes::SphereWithLods(16, 16);
+	rEye.setScale(0.05f, 0.1f, 0.1f);
+	rEye.setRotation(-0.4f, 0, 1, 0);
+	rEye.addRotation(3.14f, 0, 1, 0);
+	rEye.addRotation(3.14f, 1, 0, 0);
+	rEye.setTranslation(-1.7f, 1.87f, -0.5f);
+	rEye.texture = "textures/eye.png";
+	parts.push_back(rEye);
+
+	return parts;
+}
+
+/*
+* Stress scene: a grid of ducks drawn with hardware instancing. Parts that share both geometry and texture
+* (the body, wings and head are all blue 16x16 spheres) go in the same batch, so the whole flock costs
+* a handful of draw calls no matter how many ducks there are.
+* 
+* With separateMeshes every part of every duck is added as its own shape instead, which is the big scene
+* the multi-draw indirect path is meant for.
+*/
+void AddDuckFlock(OpenGL& GLControl, int numDucks, bool separateMeshes) {
+
+	if (numDucks <= 0) return;
+	int side = (int)std::ceil(std::sqrt((float)numDucks));
+	float spacing = 2.5f;
+
+	if (separateMeshes) {
+		std::vector<OpenGLMesh> parts = DuckParts();
+		for (int i = 0; i < numDucks; i++) {
+			for (auto part : parts) {
+				part.addTranslation((i % side - side / 2) * spacing, 0.0f, -(i / side + 2) * spacing);
+				GLControl.AddShape(part);
+			}
+		}
+		return;
 	}
-	catch (std::runtime_error e) {
-		std::cout << e.what() << std::endl;
-		return 1;
+
+	struct Batch {
+		OpenGLMesh geometry;
+		std::vector<MeshInstance> instances;
+	};
+	std::vector<Batch> batches;
+
+	std::vector<OpenGLMesh> parts = DuckParts();
+
+	for (auto& part : parts) {
+
+		// find a batch with identical vertices, indices and texture, or start one
+		Batch* batch = nullptr;
+		for (auto& candidate : batches) {
+			if (candidate.geometry.texture == part.texture
+				&& candidate.geometry.vertices == part.vertices
+				&& candidate.geometry.indices == part.indices) {
+				batch = &candidate;
+				break;
+			}
+		}
+		if (batch == nullptr) {
+			batches.push_back({ part, {} });
+			batch = &batches.back();
+		}
+
+		// each duck is the original part moved out onto the grid (behind the desk)
+		MeshInstance partInstance = part.instance();
+		for (int i = 0; i < numDucks; i++) {
+			glm::vec3 offset((i % side - side / 2) * spacing, 0.0f, -(i / side + 2) * spacing);
+			MeshInstance copy = partInstance;
+			copy.model = glm::translate(offset) * partInstance.model;
+			batch->instances.push_back(copy); // a translation does not change the normal matrix
+		}
 	}
 
+	for (auto& batch : batches) {
+		GLControl.AddInstancedShape(batch.geometry, batch.instances);
+	}
+}
+
+/*
+* Vertex throughput scene: a block of separately drawn 32x32 spheres in front of the camera, so the vertex
+* shader (not draw calls or fill) dominates the frame.
+*/
+void AddSphereField(OpenGL& GLControl, int numSpheres) {
+
+	if (numSpheres <= 0) return;
+	int side = (int)std::ceil(std::cbrt((float)numSpheres));
+	float spacing = 0.5f;
+
+	for (int i = 0; i < numSpheres; i++) {
+		int x = i % side, y = (i / side) % side, z = i / (side * side);
+		OpenGLMesh sphere = shapes::Sphere(32, 32);
+		sphere.setScale(0.2f, 0.2f, 0.2f);
+		sphere.setTranslation((x - side / 2) * spacing, 1.0f + y * spacing, -z * spacing);
+		sphere.texture = "textures/bluerubber.jpg";
+		GLControl.AddShape(sphere);
+	}
+}
+
+/*
+* The shipped scene. Shapes only, lights and camera are set up in main.
+*/
+void AddDeskScene(OpenGL& GLControl) {
+
 	/*
 	Add two cubes, scale to rectangles, rotate them slightly differently, and stack them
 	on top of each other. This will be a representation of the stack of cards in
@@ -27,7 +207,7 @@ int main() {
 	// define shape to send to scene
 	OpenGLMesh bottomCards = shapes::Cube();
 	bottomCards.setScale(1.6f, 0.4f, 1.4f);
-	bottomCards.setRotation(45.0f, 0.0f, 1.0f, 0.0f); // normals are rotated at render, vertices here
+	bottomCards.setRotation(45.0f, 0.0f, 1.0f, 0.0f); // normals follow through the normal matrix the controller builds
 	bottomCards.setTranslation(-2.0f, 0.0f, 0.0f);
 	bottomCards.texture = "textures/vegas-deck.png";
 	// add to scene
@@ -55,21 +235,21 @@ int main() {
 	* Create cylinders that will represent the shape of a candle
 	*/
 
-	OpenGLMesh CandleBottom = shapes::Cylinder(64); // a 64-sided block well approximates a cylinder
+	OpenGLMesh CandleBottom = shapes::CylinderWithLods(64); // a 64-sided block well approximates a cylinder
 	CandleBottom.setScale(1.4f, 1.8f, 1.4f);
 	CandleBottom.setRotation(3.14f, 0.0f, 1.0f, 0.0f);
 	CandleBottom.setTranslation(2.0f, 0.0f, -1.5f);
 	CandleBottom.texture = "textures/candle.jpg"; 
 	GLControl.AddShape(CandleBottom);
 
-	OpenGLMesh CandleTop = shapes::Cylinder(64);
+	OpenGLMesh CandleTop = shapes::CylinderWithLods(64);
 	CandleTop.setScale(1.45f, 0.3f, 1.45f);
 	CandleTop.setRotation(3.14f, 0.0f, 1.0f, 0.0f);
 	CandleTop.setTranslation(2.0f, 1.8f, -1.5f);
 	CandleTop.texture = "textures/lidside.png"; //lidside2.png  
 	GLControl.AddShape(CandleTop);
 
-	OpenGLMesh CandleTop2 = shapes::Cylinder(64);
+	OpenGLMesh CandleTop2 = shapes::CylinderWithLods(64);
 	CandleTop2.setScale(1.45f, 0.01f, 1.45f);
 	CandleTop2.setRotation(3.14f, 0.0f, 1.0f, 0.0f);
 	CandleTop2.setTranslation(2.0f, 2.1f, -1.5f);
@@ -80,7 +260,7 @@ int main() {
 	* Create the single rubber ball
 	*/
 
-	OpenGLMesh ball = shapes::Sphere(32, 32);
+	OpenGLMesh ball = shapes::SphereWithLods(32, 32);
 	ball.setScale(0.6f, 0.6f, 0.6f);
 	ball.setRotation(0.0f, 1.0f, 0.0f, 0.0f); 
 	ball.setTranslation(-0.25f, 0.58f, 0.25f);
@@ -91,87 +271,147 @@ int main() {
 	/*
 	* and now, 'the duck'
 	*/
-	const char* duckTexture = "textures/blue.png";
-	float duckShinyness = 0.25f;
-
-	auto body = shapes::Sphere(16, 16);
-	body.setScale(0.7f, 0.5f, 0.8f);
-	body.setRotation(0, 1, 0, 0);
-	body.setTranslation(-2.0f, 1.05, -1.0f);
-	body.texture = duckTexture;
-	body.setShininess(duckShinyness);
-	GLControl.AddShape(body);
-
-
-	auto lWing = shapes::Sphere(16, 16);
-	lWing.setScale(0.1f, 0.25f, 0.33f);
-	lWing.setRotation(0.2f, 1, 0, 0);
-	lWing.setTranslation(-2.65f, 1.05, -1.0f);
-	lWing.texture = duckTexture;
-	lWing.setShininess(duckShinyness);
-	GLControl.AddShape(lWing);
+	for (auto& part : DuckParts()) {
+		GLControl.AddShape(part);
+	}
+}
 
+/*
+* Benchmark camera paths. The desk path circles the table at varying heights, the flock path sweeps out
+* over the duck grid behind it and back.
+*/
+CameraPath DeskCameraPath() {
+	CameraPath path(2.5f);
+	glm::vec3 desk(0.0f, 1.0f, -0.5f);
+	path.AddKey(glm::vec3(0.0f, 2.0f, 6.0f), desk);
+	path.AddKey(glm::vec3(-5.5f, 3.0f, 2.0f), desk);
+	path.AddKey(glm::vec3(-4.0f, 1.5f, -5.0f), desk);
+	path.AddKey(glm::vec3(2.0f, 4.0f, -6.0f), desk);
+	path.AddKey(glm::vec3(6.0f, 2.5f, 0.0f), desk);
+	path.AddKey(glm::vec3(3.0f, 1.2f, 4.0f), glm::vec3(-1.0f, 1.0f, 0.0f));
+	return path;
+}
 
-	auto rWing = shapes::Sphere(16, 16);
-	rWing.setScale(0.1f, 0.25f, 0.33f);
-	rWing.setRotation(0.2f, 1, 0, 0);
-	rWing.setTranslation(-1.35f, 1.05, -1.0f);
-	rWing.texture = duckTexture;
-	rWing.setShininess(duckShinyness);
-	GLControl.AddShape(rWing);
+CameraPath FlockCameraPath() {
+	CameraPath path(3.0f);
+	glm::vec3 flock(0.0f, 0.0f, -25.0f);
+	path.AddKey(glm::vec3(0.0f, 3.0f, 6.0f), glm::vec3(0.0f, 1.0f, -1.0f));
+	path.AddKey(glm::vec3(-15.0f, 6.0f, -5.0f), flock);
+	path.AddKey(glm::vec3(-10.0f, 10.0f, -45.0f), flock);
+	path.AddKey(glm::vec3(10.0f, 4.0f, -40.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	path.AddKey(glm::vec3(15.0f, 6.0f, -5.0f), flock);
+	return path;
+}
 
+/*
+* Weld benchmark, CPU only. Spheres of growing tessellation are taken apart into one vertex per triangle corner
+* (what an unindexed model file gives a loader) and welded back together. If the weld is linear, the time per
+* vertex stays flat as the meshes grow. Also reports what welding the sphere as generated saves.
+*/
+void BenchmarkWeld() {
+
+	for (int tessellation = 32; tessellation <= 512; tessellation *= 2) {
+
+		OpenGLMesh sphere = shapes::Sphere(tessellation, tessellation);
+		size_t stride = sphere.floatsPerVertex + sphere.floatsPerColor + sphere.floatsPerUV + sphere.floatsPerNormal;
+
+		OpenGLMesh soup = sphere;
+		soup.vertices.clear();
+		soup.indices.clear();
+		soup.vertices.reserve(sphere.indices.size() * stride);
+		soup.indices.widenFor(sphere.indices.size());
+		for (size_t i = 0; i < sphere.indices.size(); i++) {
+			auto vertex = sphere.vertices.begin() + sphere.indices[i] * stride;
+			soup.vertices.insert(soup.vertices.end(), vertex, vertex + stride);
+			soup.indices.push_back((GLuint)i);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		WeldResult welded = WeldVertices(soup);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		WeldResult generated = WeldVertices(sphere);
+
+		std::cout << "INFO: Weld sphere " << tessellation << " x " << tessellation << ": " << welded.verticesBefore << " -> "
+			<< welded.verticesAfter << " vertices, " << (welded.bytesBefore - welded.bytesAfter) / 1024 << " KB saved in "
+			<< ms << " ms (" << ms * 1.0e6 / welded.verticesBefore << " ns per vertex). As generated: "
+			<< generated.verticesBefore << " -> " << generated.verticesAfter << " vertices" << std::endl;
+	}
+}
 
-	auto tail = shapes::Sphere(32, 32);
-	tail.setScale(0.4f, 0.15f, 0.35f);
-	tail.setRotation(1.0f, 1, 0, 0);
-	tail.setTranslation(-2.0f, 1.05, -1.7f);
-	tail.texture = duckTexture;
-	tail.setShininess(duckShinyness);
-	GLControl.AddShape(tail);
+int main(int argc, char* argv[]) {
+
+	// "--headless" renders offscreen without a display, "--frames N" / "--seconds S" end the run early
+	bool headless = false;
+	int frameLimit = 0;
+	double secondsLimit = 0.0;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--headless") headless = true;
+		else if (arg == "--frames" && i + 1 < argc) frameLimit = std::atoi(argv[i + 1]);
+		else if (arg == "--seconds" && i + 1 < argc) secondsLimit = std::atof(argv[i + 1]);
+	}
+	if (headless && frameLimit <= 0 && secondsLimit <= 0.0) frameLimit = 600; // nobody can close the window
 
+	// "--bench-weld" needs no window
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) != "--bench-weld") continue;
+		BenchmarkWeld();
+		return 0;
+	}
 
-	auto head = shapes::Sphere(16, 16);
-	head.setScale(0.4f, 0.45f, 0.45f);
-	head.setRotation(0, 1, 0, 0);
-	head.setTranslation(-2.0f, 1.85f, -.75f);
-	head.texture = duckTexture;
-	head.setShininess(duckShinyness);
-	GLControl.AddShape(head);
+	// Init OpenGL Controller
+	OpenGL GLControl;
+	try {
+		GLControl.Initialize(headless);
+	}
+	catch (std::runtime_error e) {
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
 
+	// "--mdi" draws textured shapes from one shared buffer with multi-draw indirect, has to be set before adding them
+	bool multiDraw = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--mdi") multiDraw = true;
+	}
+	if (multiDraw) GLControl.UseMultiDrawIndirect();
 
-	auto lips = shapes::Sphere(32, 32);
-	lips.setScale(0.3f, 0.12f, 0.4f);
-	lips.setRotation(0, 1, 0, 0);
-	lips.setTranslation(-2.0f, 1.60f, -0.5f);
-	lips.texture = "textures/orange.jpg";
-	GLControl.AddShape(lips);
+	// "--packed" uploads textured shapes in the compact vertex format
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--packed") GLControl.UsePackedVertices(true);
+	}
 
+	// "--no-lod" always draws shapes at full detail, to compare against level of detail selection
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--no-lod") GLControl.UseLods(false);
+	}
 
-	auto lipsTop = shapes::Sphere(32, 32);
-	lipsTop.setScale(0.2f, 0.18f, 0.2f);
-	lipsTop.setRotation(0, 1, 0, 0);
-	lipsTop.setTranslation(-2.0f, 1.67f, -0.4f);
-	lipsTop.texture = "textures/orange.jpg";
-	GLControl.AddShape(lipsTop);
+	// "--no-optimize" uploads meshes as they were generated, to compare against the mesh optimizer.
+	// "--weld-epsilon E" also merges vertices whose attributes round to the same multiple of E (ignored with
+	// "--no-optimize", in either order)
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--no-optimize") GLControl.OptimizeMeshes(false);
+		if (std::string(argv[i]) == "--weld-epsilon" && i + 1 < argc) GLControl.SetWeldEpsilon((float)std::atof(argv[i + 1]));
+	}
 
+	// the desk: cards, candle, ball and duck
+	AddDeskScene(GLControl);
 
-	auto lEye = shapes::Sphere(16, 16);
-	lEye.setScale(0.05f, 0.1f, 0.1f);
-	lEye.setRotation(0.4f, 0, 1, 0);
-	lEye.addRotation(3.14f, 1, 0, 0);
-	lEye.setTranslation(-2.3f, 1.87f, -0.5f);
-	lEye.texture = "textures/eye.png";
-	GLControl.AddShape(lEye);
+	// optional stress scene: "--ducks N" adds a flock of N more ducks through the instanced path
+	// (or as separate shapes with --mdi)
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--ducks") AddDuckFlock(GLControl, std::atoi(argv[i + 1]), multiDraw);
+	}
 
-	
-	auto rEye = shapes::Sphere(16, 16);
-	rEye.setScale(0.05f, 0.1f, 0.1f);
-	rEye.setRotation(-0.4f, 0, 1, 0);
-	rEye.addRotation(3.14f, 0, 1, 0);
-	rEye.addRotation(3.14f, 1, 0, 0);
-	rEye.setTranslation(-1.7f, 1.87f, -0.5f);
-	rEye.texture = "textures/eye.png";
-	GLControl.AddShape(rEye);
+	// "--bench-vertex N" adds N spheres and times the vertex shader instead of running interactively. Covers the
+	// plain, instanced and multi-draw indirect paths, not shapes drawn with "--packed"
+	int benchSpheres = 0;
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) != "--bench-vertex") continue;
+		benchSpheres = (i + 1 < argc) ? std::atoi(argv[i + 1]) : 0;
+		if (benchSpheres <= 0) benchSpheres = 500;
+	}
+	AddSphereField(GLControl, benchSpheres);
 	
 	/*
 	* Set starting view and projection parameters in the controller's main camera
@@ -204,7 +444,122 @@ int main() {
 	GLControl.AddLight(backLight);
 
 
+	// "--bench-path out.json" flies the scripted paths over the desk, then over the desk plus a 400 duck flock,
+	// and writes frame time percentiles for both
+	std::string benchPathFile;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--bench-path") benchPathFile = argv[i + 1];
+	}
+	if (benchPathFile != "") {
+		const float timestep = 1.0f / 60.0f;
+		std::vector<FrameTimings> runs;
+
+		CameraPath deskPath = DeskCameraPath();
+		runs.push_back(GLControl.RunCameraPath(deskPath, "desk", timestep, (int)(deskPath.getDuration() / timestep)));
+
+		AddDuckFlock(GLControl, 400, multiDraw);
+		CameraPath flockPath = FlockCameraPath();
+		runs.push_back(GLControl.RunCameraPath(flockPath, multiDraw ? "desk + 400 ducks (mdi)" : "desk + 400 ducks (instanced)",
+			timestep, (int)(flockPath.getDuration() / timestep)));
+
+		std::ofstream out(benchPathFile);
+		WriteTimingsJson(out, runs);
+		std::cout << "INFO: Wrote " << benchPathFile << std::endl;
+		return 0;
+	}
+
+	// "--replay session.bin" plays back a "--record" session of the same scene, uncapped, and writes its frame
+	// times to <name>.json and <name>.csv ("--replay-out name", "replay" by default)
+	std::string replayFile, replayOut = "replay";
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--replay") replayFile = argv[i + 1];
+		if (std::string(argv[i]) == "--replay-out") replayOut = argv[i + 1];
+	}
+	if (replayFile != "") {
+		InputRecording session;
+		try {
+			session.Load(replayFile);
+		}
+		catch (std::runtime_error& e) {
+			std::cout << e.what() << std::endl;
+			return 1;
+		}
+
+		std::vector<FrameTimings> runs;
+		runs.push_back(GLControl.RunReplay(session, replayFile));
+
+		std::ofstream json(replayOut + ".json");
+		WriteTimingsJson(json, runs);
+		std::ofstream csv(replayOut + ".csv");
+		WriteFrameTimesCsv(csv, runs.back());
+		std::cout << "INFO: Wrote " << replayOut << ".json and " << replayOut << ".csv" << std::endl;
+		return 0;
+	}
+
+	// "--profile trace.json" records CPU zones and GPU passes, the last frames are written as a Chrome trace on exit
+	std::string profileFile;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--profile") profileFile = argv[i + 1];
+	}
+	GLControl.GetProfiler().SetEnabled(profileFile != "");
+
+	// "--hud" starts with the performance overlay up
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--hud") GLControl.ShowHud(true);
+	}
+
+	// "--swap immediate|vsync|adaptive" picks how swaps wait for the display, "--fps-cap N" holds frames to N per second
+	for (int i = 1; i + 1 < argc; i++) {
+		std::string arg = argv[i], value = argv[i + 1];
+		if (arg == "--fps-cap") GLControl.SetFrameCap(std::atof(value.c_str()));
+		if (arg != "--swap") continue;
+		if (value == "immediate") GLControl.SetSwapMode(SwapMode::IMMEDIATE);
+		else if (value == "adaptive") GLControl.SetSwapMode(SwapMode::ADAPTIVE);
+		else GLControl.SetSwapMode(SwapMode::VSYNC);
+	}
+
+	// "--late-latch" samples the mouse again just before the draws go out and writes the view into a mapped buffer
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--late-latch") GLControl.UseLateLatch(true);
+	}
+
+	// the window only redraws when something on screen changes, "--continuous" renders every frame like a game
+	// loop (and so does a "--frames" run, which is counting frames)
+	bool continuous = frameLimit > 0;
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--continuous") continuous = true;
+	}
+	GLControl.SetRenderMode(continuous ? RenderMode::CONTINUOUS : RenderMode::ON_DEMAND);
+
+	// "--record session.bin" saves the input of the interactive run for "--replay"
+	std::string recordFile;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--record") recordFile = argv[i + 1];
+	}
+	InputRecording recording;
+	if (recordFile != "") GLControl.RecordInput(&recording);
+
 	// render loop
-	GLControl.RunScene();
+	GLControl.StopAfter(frameLimit, secondsLimit);
+	if (benchSpheres > 0) GLControl.BenchmarkVertexShader(300);
+	else GLControl.RunScene();
+	GLControl.RecordInput(nullptr);
+
+	if (recordFile != "") {
+		try {
+			recording.Save(recordFile);
+			std::cout << "INFO: Recorded " << recording.frames.size() << " frames, " << recording.getEventCount()
+				<< " input events to " << recordFile << std::endl;
+		}
+		catch (std::runtime_error& e) {
+			std::cout << e.what() << std::endl;
+		}
+	}
+
+	if (profileFile != "") {
+		std::ofstream out(profileFile);
+		GLControl.GetProfiler().WriteChromeTrace(out);
+		std::cout << "INFO: Wrote " << profileFile << std::endl;
+	}
 	return 0;
 }
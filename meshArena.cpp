@@ -0,0 +1,138 @@
+#include "meshArena.h"
+#include "geometryCache.h"
+
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+
+// starting sizes, enough for the desk scene without growing
+const GLsizeiptr INITIAL_VERTEX_BYTES = 4 * 1024 * 1024;
+const GLsizeiptr INITIAL_INDEX_BYTES = 1024 * 1024;
+const GLuint INITIAL_DRAWS = 1024;
+
+const GLuint DRAW_INDEX_BINDING = GeometryCache::VERTEX_BINDING + 1;
+
+void MeshArena::Initialize() {
+	Grow(vertexBuffer, vertexCapacity, 0, INITIAL_VERTEX_BYTES);
+	Grow(indexBuffer, indexCapacity, 0, INITIAL_INDEX_BYTES);
+	ReserveDraws(INITIAL_DRAWS);
+}
+
+void MeshArena::Grow(GLuint& buffer, GLsizeiptr& capacity, GLsizeiptr used, GLsizeiptr needed) {
+
+	if (needed <= capacity) return;
+	GLsizeiptr newCapacity = std::max(needed, capacity * 2);
+
+	// immutable storage cannot be resized: make a bigger buffer and copy what is there on the GPU
+	GLuint newBuffer;
+	glCreateBuffers(1, &newBuffer);
+	glNamedBufferStorage(newBuffer, newCapacity, NULL, GL_DYNAMIC_STORAGE_BIT);
+	if (buffer != 0) {
+		if (used > 0) glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, used);
+		glDeleteBuffers(1, &buffer);
+		grows++;
+	}
+	buffer = newBuffer;
+	capacity = newCapacity;
+	PointLayouts();
+}
+
+void MeshArena::ReserveDraws(GLuint count) {
+
+	if (count <= drawIndexCapacity) return;
+	GLuint newCapacity = std::max(count, drawIndexCapacity * 2);
+
+	// the contents never change, only the length: 0, 1, 2 ...
+	std::vector<GLuint> drawIndices(newCapacity);
+	std::iota(drawIndices.begin(), drawIndices.end(), 0u);
+
+	if (drawIndexBuffer != 0) glDeleteBuffers(1, &drawIndexBuffer);
+	glCreateBuffers(1, &drawIndexBuffer);
+	glNamedBufferStorage(drawIndexBuffer, sizeof(GLuint) * newCapacity, drawIndices.data(), 0);
+	drawIndexCapacity = newCapacity;
+	PointLayouts();
+}
+
+void MeshArena::PointLayouts() {
+
+	// after any buffer was replaced, every layout VAO has to read from the new one
+	for (auto& layout : mLayouts) {
+		GLint stride = sizeof(float) * (layout.floats[0] + layout.floats[1] + layout.floats[2] + layout.floats[3]);
+		glVertexArrayVertexBuffer(layout.vao, GeometryCache::VERTEX_BINDING, vertexBuffer, 0, stride);
+		glVertexArrayVertexBuffer(layout.vao, DRAW_INDEX_BINDING, drawIndexBuffer, 0, sizeof(GLuint));
+		glVertexArrayElementBuffer(layout.vao, indexBuffer);
+	}
+}
+
+int MeshArena::LayoutFor(const OpenGLMesh& mesh) {
+
+	GLuint floats[4] = { mesh.floatsPerVertex, mesh.floatsPerColor, mesh.floatsPerUV, mesh.floatsPerNormal };
+	for (int i = 0; i < (int)mLayouts.size(); i++) {
+		if (std::equal(floats, floats + 4, mLayouts[i].floats)) return i;
+	}
+
+	// new layout: same attributes as the regular path, plus the per draw index
+	Layout layout = { { floats[0], floats[1], floats[2], floats[3] }, 0 };
+	glCreateVertexArrays(1, &layout.vao);
+	GeometryCache::SetVertexAttributes(layout.vao, mesh, vertexBuffer);
+	glVertexArrayElementBuffer(layout.vao, indexBuffer);
+
+	glVertexArrayVertexBuffer(layout.vao, DRAW_INDEX_BINDING, drawIndexBuffer, 0, sizeof(GLuint));
+	glVertexArrayBindingDivisor(layout.vao, DRAW_INDEX_BINDING, 1);
+	glVertexArrayAttribIFormat(layout.vao, DRAW_INDEX_LOCATION, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(layout.vao, DRAW_INDEX_LOCATION, DRAW_INDEX_BINDING);
+	glEnableVertexArrayAttrib(layout.vao, DRAW_INDEX_LOCATION);
+
+	mLayouts.push_back(layout);
+	return (int)mLayouts.size() - 1;
+}
+
+ArenaRange MeshArena::Acquire(const OpenGLMesh& mesh, const std::string& key) {
+
+	requests++;
+	auto found = mRanges.find(key);
+	if (found != mRanges.end()) return found->second;
+
+	ArenaRange range;
+	range.layout = LayoutFor(mesh);
+
+	// vertices start on a multiple of the stride so they can be addressed in whole vertices by baseVertex
+	GLsizeiptr stride = sizeof(float) * (mesh.floatsPerVertex + mesh.floatsPerColor + mesh.floatsPerUV + mesh.floatsPerNormal);
+	GLsizeiptr vertexOffset = (vertexBytesUsed + stride - 1) / stride * stride;
+	GLsizeiptr vertexBytes = sizeof(GLfloat) * mesh.vertices.size();
+
+	// same for the indices and their width
+	GLsizeiptr indexWidth = mesh.indices.getWidth();
+	GLsizeiptr indexOffset = (indexBytesUsed + indexWidth - 1) / indexWidth * indexWidth;
+	GLsizeiptr indexBytes = mesh.indices.byteSize();
+
+	Grow(vertexBuffer, vertexCapacity, vertexBytesUsed, vertexOffset + vertexBytes);
+	Grow(indexBuffer, indexCapacity, indexBytesUsed, indexOffset + indexBytes);
+
+	glNamedBufferSubData(vertexBuffer, vertexOffset, vertexBytes, mesh.vertices.data());
+	glNamedBufferSubData(indexBuffer, indexOffset, indexBytes, mesh.indices.data());
+
+	range.baseVertex = (GLint)(vertexOffset / stride);
+	range.firstIndex = (GLuint)(indexOffset / indexWidth);
+	range.nIndices = (GLuint)mesh.indices.size();
+	range.indexType = mesh.indices.getType();
+
+	vertexBytesUsed = vertexOffset + vertexBytes;
+	indexBytesUsed = indexOffset + indexBytes;
+
+	mRanges[key] = range;
+	return range;
+}
+
+void MeshArena::Clear() {
+	mRanges.clear();
+	vertexBytesUsed = 0;
+	indexBytesUsed = 0;
+}
+
+void MeshArena::printStats() {
+
+	std::cout << "INFO: Mesh arena: " << requests << " shapes, " << mRanges.size() << " unique, " << mLayouts.size()
+		<< " vertex layouts, " << vertexBytesUsed / 1024 << " KB vertices + " << indexBytesUsed / 1024 << " KB indices, "
+		<< grows << " grows" << std::endl;
+}
@@ -0,0 +1,91 @@
+#ifndef MESHARENA_H
+#define MESHARENA_H
+
+#include <GL\glew.h>
+
+#include "openGLmesh.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/*
+* One big vertex buffer and one big index buffer that every mesh is sub-allocated from, for the multi-draw
+* indirect render path. A mesh is then just a range in each buffer, so any number of meshes with the same
+* vertex layout can be drawn from a single VAO by one glMultiDrawElementsIndirect.
+*
+* Different layouts (the cards have colors, the spheres do not) have different strides but share the vertex
+* buffer: each mesh's vertices start on a multiple of its own stride, so the draw command's baseVertex can
+* point at them. Each layout gets its own VAO over the shared buffers.
+*
+* Every layout VAO also reads a draw index (location 12, one per instance) from a buffer holding 0, 1, 2 ...
+* The draw command's baseInstance selects where in it to start, which gives the vertex shader the index of
+* its per-draw record (gl_DrawID / gl_BaseInstance would need GL 4.6).
+*
+* Indices keep the width each mesh chose (see MeshIndices) in the one index buffer, each range starting on a
+* multiple of its own width, so firstIndex can address it. A multi-draw takes a single index type, so draws are
+* grouped by it as well as by layout.
+*
+* Geometry is shared by key like the geometry cache. Buffers grow by copying on the GPU when they fill up.
+*/
+
+// where one unique geometry lives in the arena
+struct ArenaRange {
+	int layout; // index into the arena's layouts
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint nIndices;
+	GLenum indexType; // firstIndex counts in indices of this type
+};
+
+class MeshArena {
+
+	public:
+
+		static const GLuint DRAW_INDEX_LOCATION = 12;
+
+		void Initialize();
+
+		// range of this mesh's geometry, copying it in the first time the key is seen
+		ArenaRange Acquire(const OpenGLMesh& mesh, const std::string& key);
+		bool Contains(const std::string& key) const { return mRanges.count(key) > 0; }
+
+		// forget all geometry (keeps the buffers and layout VAOs for reuse)
+		void Clear();
+
+		// makes sure the draw index buffer covers draws [0, count)
+		void ReserveDraws(GLuint count);
+
+		GLuint getLayoutVao(int layout) const { return mLayouts[layout].vao; }
+		GLsizeiptr getBytesUsed() const { return vertexBytesUsed + indexBytesUsed; }
+
+		void printStats();
+
+	private:
+
+		struct Layout {
+			GLuint floats[4]; // per vertex, color, uv, normal
+			GLuint vao;
+		};
+
+		int LayoutFor(const OpenGLMesh& mesh);
+		void Grow(GLuint& buffer, GLsizeiptr& capacity, GLsizeiptr used, GLsizeiptr needed);
+		void PointLayouts();
+
+		GLuint vertexBuffer = 0;
+		GLuint indexBuffer = 0;
+		GLuint drawIndexBuffer = 0;
+		GLsizeiptr vertexCapacity = 0;
+		GLsizeiptr indexCapacity = 0;
+		GLuint drawIndexCapacity = 0;
+		GLsizeiptr vertexBytesUsed = 0;
+		GLsizeiptr indexBytesUsed = 0;
+
+		std::vector<Layout> mLayouts;
+		std::unordered_map<std::string, ArenaRange> mRanges;
+
+		int requests = 0;
+		int grows = 0;
+};
+
+#endif
@@ -0,0 +1,388 @@
+#include "meshOptimizer.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <string>
+
+// Forsyth's tuning, for a modelled LRU cache of 32 vertices
+const int MODEL_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+static size_t VertexStride(const OpenGLMesh& mesh) {
+	return mesh.floatsPerVertex + mesh.floatsPerColor + mesh.floatsPerUV + mesh.floatsPerNormal;
+}
+
+static size_t VertexCount(const OpenGLMesh& mesh) {
+	size_t stride = VertexStride(mesh);
+	return stride > 0 ? mesh.vertices.size() / stride : 0;
+}
+
+VertexCacheStats AnalyzeVertexCache(const OpenGLMesh& mesh, int cacheSize) {
+
+	VertexCacheStats stats;
+	size_t nTriangles = mesh.indices.size() / 3;
+	if (nTriangles == 0) return stats;
+
+	// a FIFO cache: a hit does not move the vertex, like the post-transform caches it stands in for
+	std::vector<int> entered(VertexCount(mesh), -1); // miss count when the vertex went in, -1 = never
+	std::vector<bool> used(entered.size(), false);
+	int misses = 0;
+	size_t usedVertices = 0;
+	for (size_t i = 0; i < nTriangles * 3; i++) {
+		GLuint vertex = mesh.indices[i];
+		if (vertex >= entered.size()) continue;
+		if (!used[vertex]) {
+			used[vertex] = true;
+			usedVertices++;
+		}
+		if (entered[vertex] >= 0 && misses - entered[vertex] < cacheSize) continue;
+		entered[vertex] = misses++;
+	}
+
+	stats.acmr = (double)misses / nTriangles;
+	stats.atvr = usedVertices > 0 ? (double)misses / usedVertices : 0.0;
+	return stats;
+}
+
+static size_t MeshBytes(const OpenGLMesh& mesh) {
+	return sizeof(GLfloat) * mesh.vertices.size() + mesh.indices.byteSize();
+}
+
+// what identifies one attribute value: its bits (with -0 made 0, so the two compare equal), or its grid cell
+static uint64_t WeldKey(float value, float epsilon) {
+	if (epsilon > 0.0f) return (uint64_t)(int64_t)std::floor((double)value / epsilon + 0.5);
+	if (value == 0.0f) value = 0.0f;
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+WeldResult WeldVertices(OpenGLMesh& mesh, float epsilon) {
+
+	size_t stride = VertexStride(mesh);
+	size_t nVertices = VertexCount(mesh);
+
+	WeldResult result;
+	result.verticesBefore = result.verticesAfter = nVertices;
+	result.bytesBefore = result.bytesAfter = MeshBytes(mesh);
+	if (nVertices < 2) return result;
+	for (size_t i = 0; i < mesh.indices.size(); i++) {
+		if (mesh.indices[i] >= nVertices) return result; // broken mesh, leave it as it is
+	}
+
+	// FNV-1a a whole key at a time rather than a byte at a time, with the high bits folded down at the end
+	// because the table is indexed by the low ones
+	auto hashVertex = [&](size_t v) {
+		uint64_t hash = FNV_OFFSET_BASIS;
+		for (size_t f = 0; f < stride; f++) hash = (hash ^ WeldKey(mesh.vertices[v * stride + f], epsilon)) * FNV_PRIME;
+		return hash ^ (hash >> 29);
+	};
+	auto sameVertex = [&](size_t a, size_t b) {
+		for (size_t f = 0; f < stride; f++) {
+			if (WeldKey(mesh.vertices[a * stride + f], epsilon) != WeldKey(mesh.vertices[b * stride + f], epsilon)) return false;
+		}
+		return true;
+	};
+
+	// open addressing, at most half full so probes stay short. Slots hold the welded number of a vertex
+	const GLuint EMPTY = 0xFFFFFFFF;
+	size_t tableSize = 1;
+	while (tableSize < nVertices * 2) tableSize <<= 1;
+	std::vector<GLuint> table(tableSize, EMPTY);
+
+	std::vector<GLuint> remap(nVertices);
+	std::vector<GLuint> kept; // original number of each welded vertex, in the order they were first seen
+	kept.reserve(nVertices);
+	for (size_t v = 0; v < nVertices; v++) {
+		size_t slot = hashVertex(v) & (tableSize - 1);
+		while (table[slot] != EMPTY && !sameVertex(kept[table[slot]], v)) slot = (slot + 1) & (tableSize - 1);
+		if (table[slot] == EMPTY) {
+			table[slot] = (GLuint)kept.size();
+			kept.push_back((GLuint)v);
+		}
+		remap[v] = table[slot];
+	}
+	if (kept.size() == nVertices) return result;
+
+	std::vector<GLfloat> vertices(kept.size() * stride);
+	for (size_t v = 0; v < kept.size(); v++) {
+		std::copy_n(mesh.vertices.begin() + kept[v] * stride, stride, vertices.begin() + v * stride);
+	}
+	mesh.vertices = std::move(vertices);
+
+	// fewer vertices can mean narrower indices
+	MeshIndices indices;
+	indices.widenFor(kept.size());
+	indices.reserve(mesh.indices.size());
+	for (size_t i = 0; i < mesh.indices.size(); i++) indices.push_back(remap[mesh.indices[i]]);
+	mesh.indices = std::move(indices);
+
+	result.verticesAfter = kept.size();
+	result.bytesAfter = MeshBytes(mesh);
+	return result;
+}
+
+static float VertexScore(int cachePosition, int remainingTriangles) {
+
+	if (remainingTriangles == 0) return -1.0f; // nothing left to draw with it
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		// the last triangle's three are scored a bit lower on purpose, so the strip does not turn back on itself
+		if (cachePosition < 3) score = LAST_TRIANGLE_SCORE;
+		else score = std::pow(1.0f - (float)(cachePosition - 3) / (MODEL_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+
+	// vertices with few triangles left get a boost, so they are finished off instead of left as lone triangles
+	score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+void OptimizeVertexCache(OpenGLMesh& mesh) {
+
+	size_t nTriangles = mesh.indices.size() / 3;
+	size_t nVertices = VertexCount(mesh);
+	if (nTriangles < 2 || nVertices == 0) return;
+
+	std::vector<GLuint> indices(nTriangles * 3);
+	for (size_t i = 0; i < indices.size(); i++) {
+		indices[i] = mesh.indices[i];
+		if (indices[i] >= nVertices) return; // broken mesh, leave it as it is
+	}
+
+	// triangles using each vertex, as one array with an offset per vertex
+	std::vector<int> remaining(nVertices, 0);
+	for (GLuint vertex : indices) remaining[vertex]++;
+	std::vector<size_t> firstTriangle(nVertices + 1, 0);
+	for (size_t v = 0; v < nVertices; v++) firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+	std::vector<int> vertexTriangles(indices.size());
+	std::vector<size_t> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) vertexTriangles[filled[indices[i]]++] = (int)(i / 3);
+
+	std::vector<int> cachePosition(nVertices, -1);
+	std::vector<float> vertexScore(nVertices);
+	for (size_t v = 0; v < nVertices; v++) vertexScore[v] = VertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScore(nTriangles);
+	std::vector<bool> emitted(nTriangles, false);
+	for (size_t t = 0; t < nTriangles; t++) {
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<GLuint> cache, nextCache;
+	cache.reserve(MODEL_CACHE_SIZE + 3);
+	nextCache.reserve(MODEL_CACHE_SIZE + 3);
+
+	MeshIndices reordered;
+	reordered.widenFor(nVertices);
+	reordered.reserve(indices.size());
+
+	int best = (int)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+	size_t nextUnemitted = 0;
+	for (size_t count = 0; count < nTriangles; count++) {
+
+		// the best triangle was not next to the cache (a new island of the mesh): take the next one left in order
+		if (best < 0) {
+			while (emitted[nextUnemitted]) nextUnemitted++;
+			best = (int)nextUnemitted;
+		}
+
+		emitted[best] = true;
+		const GLuint* corners = &indices[best * 3];
+		for (int c = 0; c < 3; c++) {
+			reordered.push_back(corners[c]);
+
+			// it no longer needs this vertex
+			GLuint vertex = corners[c];
+			int* triangles = &vertexTriangles[firstTriangle[vertex]];
+			int* end = triangles + remaining[vertex];
+			std::iter_swap(std::find(triangles, end, best), end - 1);
+			remaining[vertex]--;
+		}
+
+		// LRU: the three corners go to the front, everything else moves down, the oldest fall out
+		nextCache.assign(corners, corners + 3);
+		for (GLuint vertex : cache) {
+			if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) nextCache.push_back(vertex);
+		}
+		for (size_t i = MODEL_CACHE_SIZE; i < nextCache.size(); i++) {
+			cachePosition[nextCache[i]] = -1;
+			vertexScore[nextCache[i]] = VertexScore(-1, remaining[nextCache[i]]);
+		}
+		if (nextCache.size() > (size_t)MODEL_CACHE_SIZE) nextCache.resize(MODEL_CACHE_SIZE);
+		std::swap(cache, nextCache);
+
+		// only the triangles around the cache change score, and the next triangle is picked among them
+		for (size_t i = 0; i < cache.size(); i++) {
+			cachePosition[cache[i]] = (int)i;
+			vertexScore[cache[i]] = VertexScore((int)i, remaining[cache[i]]);
+		}
+		best = -1;
+		float bestScore = -1.0f;
+		for (GLuint vertex : cache) {
+			for (int n = 0; n < remaining[vertex]; n++) {
+				int t = vertexTriangles[firstTriangle[vertex] + n];
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+	}
+
+	mesh.indices = std::move(reordered);
+}
+
+void OptimizeVertexFetch(OpenGLMesh& mesh) {
+
+	size_t nVertices = VertexCount(mesh);
+	size_t stride = VertexStride(mesh);
+	if (nVertices == 0 || mesh.indices.empty()) return;
+
+	// new numbers in order of first use, anything no triangle uses goes after
+	const GLuint UNASSIGNED = 0xFFFFFFFF;
+	std::vector<GLuint> remap(nVertices, UNASSIGNED);
+	GLuint next = 0;
+	for (size_t i = 0; i < mesh.indices.size(); i++) {
+		GLuint vertex = mesh.indices[i];
+		if (vertex >= nVertices) return;
+		if (remap[vertex] == UNASSIGNED) remap[vertex] = next++;
+	}
+	for (auto& slot : remap) {
+		if (slot == UNASSIGNED) slot = next++;
+	}
+
+	std::vector<GLfloat> vertices(mesh.vertices.size());
+	for (size_t v = 0; v < nVertices; v++) {
+		std::copy_n(mesh.vertices.begin() + v * stride, stride, vertices.begin() + remap[v] * stride);
+	}
+	mesh.vertices = std::move(vertices);
+
+	MeshIndices indices;
+	indices.widenFor(nVertices);
+	indices.reserve(mesh.indices.size());
+	for (size_t i = 0; i < mesh.indices.size(); i++) indices.push_back(remap[mesh.indices[i]]);
+	mesh.indices = std::move(indices);
+}
+
+// which way the normal mostly points: +x, -x, +y, -y, +z, -z
+static int NormalBucket(const OpenGLMesh& mesh, const GLfloat* vertex) {
+	if (mesh.floatsPerNormal < 3) return 0;
+	const GLfloat* n = vertex + mesh.floatsPerVertex + mesh.floatsPerColor + mesh.floatsPerUV;
+	int axis = 0;
+	for (int i = 1; i < 3; i++) {
+		if (std::abs(n[i]) > std::abs(n[axis])) axis = i;
+	}
+	return axis * 2 + (n[axis] < 0.0f ? 1 : 0);
+}
+
+OpenGLMesh SimplifyMesh(const OpenGLMesh& mesh, int cellsPerAxis) {
+
+	OpenGLMesh simplified;
+	simplified.floatsPerVertex = mesh.floatsPerVertex;
+	simplified.floatsPerColor = mesh.floatsPerColor;
+	simplified.floatsPerUV = mesh.floatsPerUV;
+	simplified.floatsPerNormal = mesh.floatsPerNormal;
+	simplified.texture = mesh.texture;
+
+	size_t stride = VertexStride(mesh);
+	size_t nVertices = VertexCount(mesh);
+	if (nVertices == 0 || mesh.floatsPerVertex < 3 || cellsPerAxis < 1) return simplified;
+
+	glm::vec3 low(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]), high = low;
+	for (size_t v = 1; v < nVertices; v++) {
+		glm::vec3 position(mesh.vertices[v * stride], mesh.vertices[v * stride + 1], mesh.vertices[v * stride + 2]);
+		low = glm::min(low, position);
+		high = glm::max(high, position);
+	}
+	glm::vec3 size = high - low;
+	float cellSize = std::max(size.x, std::max(size.y, size.z)) / cellsPerAxis;
+	if (cellSize <= 0.0f) return simplified;
+
+	// cluster of every vertex, keyed by cell and normal direction
+	std::unordered_map<uint64_t, GLuint> clusters;
+	clusters.reserve(nVertices);
+	std::vector<GLuint> clusterOf(nVertices);
+	std::vector<GLuint> firstVertex; // its attributes (uv, normal, color) stand for the whole cluster
+	std::vector<glm::vec3> positionSum;
+	std::vector<int> members;
+	for (size_t v = 0; v < nVertices; v++) {
+
+		const GLfloat* vertex = &mesh.vertices[v * stride];
+		glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+		glm::vec3 cell = glm::floor((position - low) / cellSize);
+		uint64_t key = (uint64_t)cell.x;
+		key = key * (cellsPerAxis + 1) + (uint64_t)cell.y;
+		key = key * (cellsPerAxis + 1) + (uint64_t)cell.z;
+		key = key * 6 + NormalBucket(mesh, vertex);
+
+		auto found = clusters.emplace(key, (GLuint)firstVertex.size());
+		if (found.second) {
+			firstVertex.push_back((GLuint)v);
+			positionSum.push_back(glm::vec3(0.0f));
+			members.push_back(0);
+		}
+		GLuint cluster = found.first->second;
+		clusterOf[v] = cluster;
+		positionSum[cluster] += position;
+		members[cluster]++;
+	}
+
+	simplified.vertices.resize(firstVertex.size() * stride);
+	for (size_t c = 0; c < firstVertex.size(); c++) {
+		GLfloat* out = &simplified.vertices[c * stride];
+		std::copy_n(mesh.vertices.begin() + firstVertex[c] * stride, stride, out);
+		glm::vec3 average = positionSum[c] / (float)members[c];
+		out[0] = average.x;
+		out[1] = average.y;
+		out[2] = average.z;
+	}
+
+	simplified.indices.widenFor(firstVertex.size());
+	for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+		if (mesh.indices[t] >= nVertices || mesh.indices[t + 1] >= nVertices || mesh.indices[t + 2] >= nVertices) continue;
+		GLuint a = clusterOf[mesh.indices[t]], b = clusterOf[mesh.indices[t + 1]], c = clusterOf[mesh.indices[t + 2]];
+		if (a == b || b == c || a == c) continue; // collapsed
+		simplified.indices.push_back(a);
+		simplified.indices.push_back(b);
+		simplified.indices.push_back(c);
+	}
+	return simplified;
+}
+
+std::vector<OpenGLMesh> GenerateLods(const OpenGLMesh& mesh, int maxLevels) {
+
+	std::vector<OpenGLMesh> lods;
+	size_t triangles = mesh.indices.size() / 3;
+
+	// each level is simplified from the full mesh, not the level before, so errors do not pile up
+	for (int cells = 64; cells >= 2 && (int)lods.size() < maxLevels; cells /= 2) {
+		OpenGLMesh level = SimplifyMesh(mesh, cells);
+		size_t levelTriangles = level.indices.size() / 3;
+		if (levelTriangles == 0) break;
+		if (levelTriangles > triangles * LOD_REDUCTION) continue; // too close to the last level to be worth one
+		if (mesh.geometryKey != "") level.geometryKey = mesh.geometryKey + " simplified " + std::to_string(cells);
+		triangles = levelTriangles;
+		lods.push_back(std::move(level));
+	}
+	return lods;
+}
+
+MeshOptimization OptimizeMesh(OpenGLMesh& mesh, float weldEpsilon) {
+
+	MeshOptimization result;
+	result.before = AnalyzeVertexCache(mesh);
+	result.weld = WeldVertices(mesh, weldEpsilon);
+	OptimizeVertexCache(mesh);
+	OptimizeVertexFetch(mesh);
+	result.after = AnalyzeVertexCache(mesh);
+	return result;
+}
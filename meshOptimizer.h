@@ -0,0 +1,65 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "openGLmesh.h"
+
+/*
+* Passes over meshes before they are uploaded. None of them changes what is drawn.
+*
+* WeldVertices merges vertices that are equal in every attribute (position, color, uv and normal alike) and points
+* the indices at the one that is kept. With an epsilon, values are compared by the cell of an epsilon sized grid
+* they round to instead of bit for bit, so near equal vertices merge too (two that are within epsilon but round to
+* neighbouring cells stay apart). One pass with a hash table: linear in the vertex count.
+*
+* OptimizeVertexCache reorders triangles so each one reuses vertices the GPU has just transformed (Forsyth's
+* linear speed algorithm: every vertex is scored on how recently it was used and how many triangles still need
+* it, and the next triangle is the best scoring one around the last few). OptimizeVertexFetch then renumbers the
+* vertices in the order the triangles first use them, so the vertex fetches walk the buffer forwards.
+*
+* SimplifyMesh is vertex clustering for levels of detail: vertices whose positions share a cell of a grid laid over
+* the mesh bounds (and whose normals point the same general way, so hard edges survive) become one vertex at their
+* average position, and triangles left with fewer than three distinct corners are dropped. Crude next to edge
+* collapse, but linear, and works on any mesh. GenerateLods runs it at halving grid resolutions.
+*
+* AnalyzeVertexCache measures the result on a FIFO post-transform cache like the hardware's:
+*   ACMR, vertices transformed per triangle (3 is no reuse at all, a regular grid approaches 0.5)
+*   ATVR, vertices transformed per vertex in the mesh (1 is every vertex exactly once)
+*/
+
+struct VertexCacheStats {
+	double acmr = 0.0;
+	double atvr = 0.0;
+};
+
+struct WeldResult {
+	size_t verticesBefore = 0;
+	size_t verticesAfter = 0;
+	size_t bytesBefore = 0; // vertices + indices
+	size_t bytesAfter = 0;
+};
+
+struct MeshOptimization {
+	WeldResult weld;
+	VertexCacheStats before;
+	VertexCacheStats after;
+};
+
+VertexCacheStats AnalyzeVertexCache(const OpenGLMesh& mesh, int cacheSize = 16);
+
+// epsilon 0 = exact (bit for bit, except -0 equals 0)
+WeldResult WeldVertices(OpenGLMesh& mesh, float epsilon = 0.0f);
+
+void OptimizeVertexCache(OpenGLMesh& mesh);
+void OptimizeVertexFetch(OpenGLMesh& mesh);
+
+// cellsPerAxis cells along the longest side of the bounds
+OpenGLMesh SimplifyMesh(const OpenGLMesh& mesh, int cellsPerAxis);
+
+// coarser copies for OpenGLMesh::lods, each with at most LOD_REDUCTION of the triangles of the one before
+const float LOD_REDUCTION = 0.6f;
+std::vector<OpenGLMesh> GenerateLods(const OpenGLMesh& mesh, int maxLevels = 3);
+
+// weld, then both reordering passes, measured before and after
+MeshOptimization OptimizeMesh(OpenGLMesh& mesh, float weldEpsilon = 0.0f);
+
+#endif
@@ -1,11 +1,13 @@
 #include "openGLcontroller.h"
 #include "shaders.h"
+#include "meshOptimizer.h"
 
 #include <stdexcept>
 #include <iostream>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <cstddef> // offsetof
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
 
 #define WINDOW_WIDTH 1024
 #define WINDOW_HEIGHT 768
@@ -21,27 +23,62 @@ const struct {
 	float A = 1.0f;
 } DEFAULT_COLOR;
 
-void OpenGL::Initialize() {
+void OpenGL::Initialize(bool headless) {
+
+	this->headless = headless;
+
+#ifdef GLFW_PLATFORM_NULL
+	// GLFW 3.4+: no display server at all, the window is only a holder for the context
+	if (headless) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
 
 	// Initialize GLFW library, for drawing windows and context
 	if (!glfwInit()) throw std::runtime_error("GLFW did not initialize properly");
 	SetVersionInfo();
-	CreateWindow();
+	if (headless) CreateHeadlessContext();
+	else CreateWindow();
 
 	// Initialize GLEW library, for drawing shapes
-	if (glewInit() != GLEW_OK) throw std::runtime_error("GLEW did not initialize properly");
+	// (GLEW built for GLX reports a missing X display after loading the core entry points, which is expected
+	// with an OSMesa or EGL context and harmless)
+	GLenum glewStatus = glewInit();
+	if (glewStatus != GLEW_OK && !(headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY))
+		throw std::runtime_error("GLEW did not initialize properly");
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
+	std::cout << "INFO: OpenGL Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+	if (headless) CreateOffscreenTarget();
+	else AssignCallbackRoutines();
+	ApplySwapMode();
 
-	AssignCallbackRoutines();
+	// textures decode on worker threads from here on, meshes show a placeholder until theirs arrives
+	textureCache.Initialize();
 
 	// Build shaders
 	//this->colorShader = BuildShaderProgram(vertexShaderSource, colorShaderSource);
 	this->textureShader = BuildShaderProgram(vertexShaderSource, textureShaderSource);
+	this->textureUniforms = ResolveUniforms(textureShader);
+	this->instancedTextureShader = BuildShaderProgram(instancedVertexShaderSource, textureShaderSource);
+	this->instancedUniforms = ResolveUniforms(instancedTextureShader);
+
+	// the sampler always reads texture unit 0, so this only has to be set once per program
+	glState.UseProgram(textureShader);
+	textureUniforms.texture.set(0);
+	glState.UseProgram(instancedTextureShader);
+	instancedUniforms.texture.set(0);
+
+	// overlay, hidden until toggled
+	this->hudShader = BuildShaderProgram(hudVertexShaderSource, hudFragmentShaderSource);
+	hud.Initialize(hudShader, mUniformTables[hudShader]);
+
+	// camera and lights live in uniform blocks at fixed binding points, so every program sees the same data
+	frameUniformBuffer.Create(FRAME_BLOCK_BINDING, sizeof(FrameBlock));
+	lightUniformBuffer.Create(LIGHT_BLOCK_BINDING, sizeof(LightBlock));
 }
 
 void OpenGL::SetVersionInfo() {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5); // 4.5 for direct state access
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 }
 
@@ -59,8 +96,97 @@ void OpenGL::CreateWindow() {
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 }
 
+void OpenGL::CreateHeadlessContext() {
+
+	// hidden window, context from OSMesa (software, Mesa llvmpipe) or failing that EGL. Either one
+	// needs no display, the frames go to the offscreen target instead
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+#if defined(GLFW_OSMESA_CONTEXT_API) && defined(GLFW_EGL_CONTEXT_API)
+	const int contextApis[] = { GLFW_OSMESA_CONTEXT_API, GLFW_EGL_CONTEXT_API };
+	for (int api : contextApis) {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+		this->window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
+		if (window != nullptr) break;
+	}
+#else
+	this->window = nullptr;
+#endif
+
+	if (window == nullptr) throw std::runtime_error("Failed to create a headless GL 4.5 context (needs GLFW 3.3+ built with OSMesa or EGL)");
+	glfwMakeContextCurrent(window);
+}
+
+void OpenGL::CreateOffscreenTarget() {
+
+	// color + depth renderbuffers at the window size, bound once: nothing else in the renderer binds framebuffers
+	glCreateRenderbuffers(1, &offscreenColor);
+	glCreateRenderbuffers(1, &offscreenDepth);
+	glNamedRenderbufferStorage(offscreenColor, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT);
+	glNamedRenderbufferStorage(offscreenDepth, GL_DEPTH24_STENCIL8, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+	glCreateFramebuffers(1, &offscreenFramebuffer);
+	glNamedFramebufferRenderbuffer(offscreenFramebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor);
+	glNamedFramebufferRenderbuffer(offscreenFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth);
+	if (glCheckNamedFramebufferStatus(offscreenFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		throw std::runtime_error("Offscreen framebuffer is incomplete");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreenFramebuffer);
+	glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+	glClearColor(DEFAULT_COLOR.R, DEFAULT_COLOR.G, DEFAULT_COLOR.B, DEFAULT_COLOR.A);
+}
+
+void OpenGL::ShowHud(bool visible) {
+	hudVisible = visible;
+	sceneDirty = true;
+}
+
+void OpenGL::UseLateLatch(bool enabled) {
+
+	if (enabled && !frameRing.created()) frameRing.Create(FRAME_BLOCK_BINDING, sizeof(FrameBlock));
+	lateLatch = enabled;
+	if (!enabled) frameUniformBuffer.Bind(); // back to the block UpdateSharedUniforms keeps
+}
+
+void OpenGL::SetSwapMode(SwapMode mode) {
+	swapMode = mode;
+	ApplySwapMode();
+}
+
+void OpenGL::ApplySwapMode() {
+
+	switch (swapMode) {
+
+		case SwapMode::IMMEDIATE:
+			glfwSwapInterval(0);
+			break;
+
+		case SwapMode::ADAPTIVE:
+			// a negative interval (late frames swap at once) needs the swap_control_tear extension
+			if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+				glfwSwapInterval(-1);
+				break;
+			}
+			std::cout << "INFO: Adaptive sync is not supported here, using vsync" << std::endl;
+			swapMode = SwapMode::VSYNC;
+			glfwSwapInterval(1);
+			break;
+
+		default:
+			glfwSwapInterval(1);
+			break;
+	}
+}
+
+void OpenGL::StopAfter(int frames, double seconds) {
+	maxFrames = frames;
+	maxSeconds = seconds;
+}
+
 void OpenGL::AssignCallbackRoutines() {
+	glfwSetWindowUserPointer(window, this); // how the callbacks find this controller's queue
 	glfwSetFramebufferSizeCallback(window, Callbacks::_resizeWindow);
+	glfwSetWindowRefreshCallback(window, Callbacks::_refreshWindow);
 	glfwSetCursorPosCallback(window, Callbacks::_mousePosition);
 	glfwSetScrollCallback(window, Callbacks::_mouseScroll);
 	glfwSetKeyCallback(window, Callbacks::_keyPress);
@@ -95,9 +221,24 @@ GLuint OpenGL::BuildShaderProgram(const char* vertexShaderSource, const char* fr
 	glLinkProgram(shaderProgramID);
 	checkShaderLink(shaderProgramID);
 
+	// enumerate uniforms now so the render loop never looks them up by name
+	mUniformTables[shaderProgramID].Reflect(shaderProgramID);
+
 	return shaderProgramID;
 }
 
+OpenGL::ShaderUniforms OpenGL::ResolveUniforms(GLuint shaderProgramID) {
+
+	const UniformTable& table = mUniformTables[shaderProgramID];
+
+	ShaderUniforms uniforms;
+	uniforms.model = table.get<glm::mat4>("model");
+	uniforms.normalMatrix = table.get<glm::mat3>("normalMatrix");
+	uniforms.shininess = table.get<float>("shininess");
+	uniforms.texture = table.get<GLint>("uTexture");
+	return uniforms;
+}
+
 void OpenGL::checkShaderCompilation(GLuint& shaderID) {
 
 	int success;
@@ -129,315 +270,1185 @@ void OpenGL::checkShaderLink(GLuint& shaderID) {
 }
 
 void OpenGL::AddLight(Light light) {
+	if (mLightingArray.size() >= MAX_LIGHTS) throw std::runtime_error("Too many lights, the shader supports MAX_LIGHTS");
 	mLightingArray.push_back(light);
+	sceneDirty = true;
 }
 
-void OpenGL::AddShape(OpenGLMesh& meshInfo) {
+Light* OpenGL::GetLight(int index) {
+	if (index < 0 || index >= (int)mLightingArray.size()) return nullptr;
+	return &mLightingArray[index];
+}
 
-	// create a new vertex array
-	meshID newMesh;
-	glGenVertexArrays(1, &newMesh.vao);
-	glBindVertexArray(newMesh.vao);
+void OpenGL::UseMultiDrawIndirect() {
 
-	//determine the byte size of the data in meshInfo vectors (for GPU buffer)
-	auto vertByteSize = sizeof(GLfloat) * meshInfo.vertices.size();
-	auto indexByteSize = sizeof(GLuint) * meshInfo.indices.size();
+	if (multiDrawIndirect) return;
+	if (!meshIds.empty()) throw std::runtime_error("Multi-draw indirect has to be chosen before shapes are added");
 
-	// create two vbos for array
-	glGenBuffers(2, newMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, newMesh.vbos[0]);     
-	glBufferData(GL_ARRAY_BUFFER, vertByteSize, &(meshInfo.vertices)[0], GL_STATIC_DRAW); // send to GPU memory
-	// &(meshInfo.vertices)[0] = pointer to vectors backing array https://stackoverflow.com/questions/2923272/how-to-convert-vector-to-array/2923295#2923295
+	multiDrawIndirect = true;
+	meshArena.Initialize();
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, newMesh.vbos[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexByteSize, &(meshInfo.indices)[0], GL_STATIC_DRAW); // send to GPU memory
+	this->indirectShader = BuildShaderProgram(indirectVertexShaderSource, textureShaderSource);
+	this->indirectUniforms = ResolveUniforms(indirectShader);
+	glState.UseProgram(indirectShader);
+	indirectUniforms.texture.set(0);
 
-	// ---- Create the Vertex Attribute Pointers ----
-	// (these are referenced by the shaders) 
+	glCreateBuffers(1, &drawRecordBuffer);
+	glCreateBuffers(1, &indirectBuffer);
+}
 
-	//size in memory between each point/color combo defines stride
-	GLint stride = sizeof(float) * (meshInfo.floatsPerVertex + meshInfo.floatsPerColor + meshInfo.floatsPerUV + meshInfo.floatsPerNormal);
- 
-	// location 0 starts at 0, moves length of stride, and picks floatspervertex = 3 values each
-	glVertexAttribPointer(0, meshInfo.floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0);
+void OpenGL::UsePackedVertices(bool enabled) {
 
-	// location 1 starts after floatsperindex=3 (times memory size), moves length of stride, and picks floatspercolor=4 values each
-	glVertexAttribPointer(1, meshInfo.floatsPerColor, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * meshInfo.floatsPerVertex));
-	glEnableVertexAttribArray(1);
+	packedVertices = enabled;
+	if (!enabled || packedTextureShader != 0) return;
 
-	// generate texture if there is one
-	newMesh.texture = 0;
-	if (meshInfo.texture != "") {
+	this->packedTextureShader = BuildShaderProgram(packedVertexShaderSource, textureShaderSource);
+	this->packedUniforms = ResolveUniforms(packedTextureShader);
+	glState.UseProgram(packedTextureShader);
+	packedUniforms.texture.set(0);
+}
 
-		newMesh.texture = AddTexture(meshInfo.texture.c_str());
+int OpenGL::AddShape(OpenGLMesh& meshInfo) {
 
-		// make texture info from this mesh available to shader
-		glVertexAttribPointer(2, meshInfo.floatsPerUV, GL_FLOAT, GL_FALSE, stride,
-			(void*)(sizeof(float) * (meshInfo.floatsPerVertex + meshInfo.floatsPerColor)));
-		glEnableVertexAttribArray(2);
+	meshID newMesh;
+	newMesh.inArena = multiDrawIndirect && meshInfo.texture != ""; // the arena path has no untextured shader
+	bool packed = packedVertices && meshInfo.texture != "" && !newMesh.inArena; // the color shader has no packed version
+
+	// the levels come without the texture, it is set on the finest one
+	newMesh.lods.push_back(AcquireLevel(meshInfo, newMesh.inArena, packed));
+	for (auto& level : LodChain(meshInfo)) {
+		newMesh.lods.push_back(AcquireLevel(level, newMesh.inArena, packed));
 	}
+	newMesh.useLod(0);
+	if (newMesh.inArena) indirectDirty = true;
+
+	// bounding sphere, for how big the shape is on screen
+	size_t stride = meshInfo.floatsPerVertex + meshInfo.floatsPerColor + meshInfo.floatsPerUV + meshInfo.floatsPerNormal;
+	glm::vec3 low(0.0f), high(0.0f);
+	for (size_t v = 0; v + 2 < meshInfo.vertices.size(); v += stride) {
+		glm::vec3 position(meshInfo.vertices[v], meshInfo.vertices[v + 1], meshInfo.vertices[v + 2]);
+		low = (v == 0) ? position : glm::min(low, position);
+		high = (v == 0) ? position : glm::max(high, position);
+	}
+	newMesh.bounds = glm::vec4((low + high) * 0.5f, glm::length(high - low) * 0.5f);
 
-	// location 3 will hold model normals
-	glVertexAttribPointer(3, meshInfo.floatsPerNormal, GL_FLOAT, GL_FALSE, stride,
-		(void*)(sizeof(float) * (meshInfo.floatsPerVertex + meshInfo.floatsPerColor + meshInfo.floatsPerUV)));
-	glEnableVertexAttribArray(3);
+	// generate texture if there is one (it loads in the background, render binds whatever is resident)
+	newMesh.texture = 0;
+	newMesh.boundTexture = 0;
+	if (meshInfo.texture != "") {
+		newMesh.texture = AddTexture(meshInfo.texture.c_str());
+		newMesh.boundTexture = textureCache.Resolve(newMesh.texture);
+	}
 
 	// link some data from the meshInfo that will be needed at render
 	newMesh.model = meshInfo.model();
-	newMesh.nIndices = meshInfo.nIndices();
-	newMesh.rotation = meshInfo.getRotation();
+	newMesh.normalMatrix = meshInfo.normalMatrix(); // recomputed only when SetShapeTransform moves the shape
 	newMesh.shininess = meshInfo.getShininess();
+	newMesh.current = meshInfo.transform();
+	newMesh.previous = newMesh.current;
+	newMesh.moved = false;
 	
 	this->meshIds.push_back(newMesh); //add object to render queue
+	sceneDirty = true;
+	return (int)meshIds.size() - 1;
 }
 
-GLuint OpenGL::AddTexture(const char* fileName) {
+void OpenGL::SetShapeTransform(int shape, OpenGLMesh& meshInfo) {
+
+	if (shape < 0 || shape >= (int)meshIds.size()) throw std::runtime_error("SetShapeTransform: no shape with that handle");
+
+	meshID& mesh = meshIds[shape];
+	mesh.current = meshInfo.transform();
+	if (simulating) {
+		// the model is blended in from the previous step when frames are drawn, see InterpolateShapes
+		if (!mesh.moved) {
+			mesh.moved = true;
+			movedShapes.push_back(shape);
+		}
+	}
+	else {
+		// the render queue reads these every frame, the indirect path keeps them in its draw records
+		mesh.previous = mesh.current;
+		mesh.model = meshInfo.model();
+		mesh.normalMatrix = meshInfo.normalMatrix();
+		if (mesh.inArena) indirectDirty = true;
+	}
+	sceneDirty = true;
+}
+
+void OpenGL::AddInstancedShape(OpenGLMesh& meshInfo, const std::vector<MeshInstance>& instances) {
+
+	if (meshInfo.texture == "") throw std::runtime_error("Instanced shapes need a texture");
+	if (instances.empty()) return;
+
+	// shared geometry buffers, plus a batch VAO that adds one MeshInstance per copy on top of them
+	instancedMeshID newBatch;
+	OpenGLMesh optimized;
+	newBatch.geometry = geometryCache.Acquire(PrepareGeometry(meshInfo, false, false, optimized));
+
+	glCreateBuffers(1, &newBatch.instanceBuffer);
+	glNamedBufferStorage(newBatch.instanceBuffer, sizeof(MeshInstance) * instances.size(), instances.data(), 0);
+
+	// per vertex data on the geometry's binding, per instance data on the next one, advancing once per instance
+	const GLuint INSTANCE_BINDING = GeometryCache::VERTEX_BINDING + 1;
+	glCreateVertexArrays(1, &newBatch.vao);
+	GeometryCache::SetVertexAttributes(newBatch.vao, meshInfo, newBatch.geometry->vbo);
+	glVertexArrayElementBuffer(newBatch.vao, newBatch.geometry->ibo);
+	glVertexArrayVertexBuffer(newBatch.vao, INSTANCE_BINDING, newBatch.instanceBuffer, 0, sizeof(MeshInstance));
+	glVertexArrayBindingDivisor(newBatch.vao, INSTANCE_BINDING, 1);
+
+	// a mat4 attribute is four vec4 locations and a mat3 is three vec3 locations
+	for (int column = 0; column < 4; column++) {
+		GeometryCache::EnableAttribute(newBatch.vao, 4 + column, 4,
+			offsetof(MeshInstance, model) + sizeof(glm::vec4) * column, INSTANCE_BINDING);
+	}
+	for (int column = 0; column < 3; column++) {
+		GeometryCache::EnableAttribute(newBatch.vao, 8 + column, 3,
+			offsetof(MeshInstance, normalMatrix) + sizeof(glm::vec3) * column, INSTANCE_BINDING);
+	}
+	GeometryCache::EnableAttribute(newBatch.vao, 11, 1, offsetof(MeshInstance, shininess), INSTANCE_BINDING);
+
+	newBatch.texture = AddTexture(meshInfo.texture.c_str());
+	newBatch.boundTexture = textureCache.Resolve(newBatch.texture);
+	newBatch.nIndices = newBatch.geometry->nIndices;
+	newBatch.indexType = newBatch.geometry->indexType;
+	newBatch.nInstances = (GLsizei)instances.size();
+
+	this->instancedMeshIds.push_back(newBatch);
+	sceneDirty = true;
+}
+
+OpenGL::LodLevel OpenGL::AcquireLevel(OpenGLMesh& meshInfo, bool inArena, bool packed) {
+
+	LodLevel level;
+	OpenGLMesh optimized;
+	if (inArena) {
+		// a range of the shared buffers, drawn through the layout's VAO
+		OpenGLMesh& geometry = PrepareGeometry(meshInfo, true, false, optimized);
+		level.geometry = nullptr;
+		level.arena = meshArena.Acquire(geometry, GeometryCache::KeyFor(geometry));
+		level.vao = meshArena.getLayoutVao(level.arena.layout);
+		level.nIndices = level.arena.nIndices;
+		level.indexType = level.arena.indexType;
+		level.packed = false;
+		level.decode = glm::mat4(1.0f);
+	}
+	else {
+		// get the shared VAO/buffers for this geometry, they are only uploaded the first time it is seen
+		level.geometry = geometryCache.Acquire(PrepareGeometry(meshInfo, false, packed, optimized), packed);
+		level.arena = {};
+		level.vao = level.geometry->vao;
+		level.nIndices = level.geometry->nIndices;
+		level.indexType = level.geometry->indexType;
+		level.packed = level.geometry->packed;
+		level.decode = level.geometry->decode;
+	}
+	return level;
+}
 
-	GLuint textureId;
-	int width, height, channels;
+std::vector<OpenGLMesh>& OpenGL::LodChain(OpenGLMesh& meshInfo) {
 
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char* image = stbi_load(fileName, &width, &height, &channels, 0);
-	if (!image) throw std::runtime_error("Could not load image");
+	static std::vector<OpenGLMesh> none;
+	if (!useLods) return none;
+	if (!meshInfo.lods.empty() || meshInfo.indices.size() / 3 < SIMPLIFY_MIN_TRIANGLES) return meshInfo.lods;
+
+	// simplified once per geometry, every copy of the mesh shares the levels
+	std::string key = GeometryCache::KeyFor(meshInfo);
+	auto found = simplifiedLods.find(key);
+	if (found == simplifiedLods.end()) {
+		found = simplifiedLods.emplace(key, GenerateLods(meshInfo)).first;
+		std::cout << "INFO: Simplified \"" << key << "\" into " << found->second.size() << " levels:";
+		for (auto& level : found->second) std::cout << " " << level.indices.size() / 3;
+		std::cout << " triangles (from " << meshInfo.indices.size() / 3 << ")" << std::endl;
+	}
+	return found->second;
+}
 
-	glGenTextures(1, &textureId);
-	glBindTexture(GL_TEXTURE_2D, textureId);
+bool OpenGL::SelectLod(meshID& mesh, float screenHeight) {
 
-	// Set the texture wrapping parameters.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	// Set texture filtering parameters.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// projected diameter of the bounding sphere in pixels, w is the view depth (1 for the orthographic projection)
+	glm::vec3 center = glm::vec3(mesh.model * glm::vec4(glm::vec3(mesh.bounds), 1.0f));
+	float scale = std::max(glm::length(glm::vec3(mesh.model[0])), std::max(glm::length(glm::vec3(mesh.model[1])), glm::length(glm::vec3(mesh.model[2]))));
+	float w = (projection * view * glm::vec4(center, 1.0f)).w;
+	float pixels = mesh.bounds.w * scale * projection[1][1] / std::max(w, NEAR_PLANE) * screenHeight;
+	float wanted = pixels * pixels / LOD_PIXELS_PER_TRIANGLE;
 
-	if (channels == 3)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	else if (channels == 4)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-	else
-		throw std::runtime_error("Cannot handle channels other than 3 or 4");
+	auto triangles = [&](int level) { return (float)(mesh.lods[level].nIndices / 3); };
+	int level = mesh.lod;
+	while (level > 0 && triangles(level) < wanted) level--; // finer as soon as this one is not enough
+	while (level + 1 < (int)mesh.lods.size() && triangles(level + 1) >= wanted * (1.0f + LOD_HYSTERESIS)) level++;
 
-	glGenerateMipmap(GL_TEXTURE_2D);
+	if (level == mesh.lod) return false;
+	mesh.useLod(level);
+	lodSwitches++;
+	return true;
+}
 
-	stbi_image_free(image);
-	glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture.
+OpenGLMesh& OpenGL::PrepareGeometry(OpenGLMesh& meshInfo, bool inArena, bool packed, OpenGLMesh& optimized) {
+
+	if (!optimizeMeshes) return meshInfo;
+
+	// geometry already on the GPU was optimized when it went up, only new keys are worth the work
+	std::string key = GeometryCache::KeyFor(meshInfo);
+	if (inArena ? meshArena.Contains(key) : geometryCache.Contains(GeometryCache::KeyFor(meshInfo, packed))) return meshInfo;
+
+	// the copy keeps the key of the original, so the next identical mesh finds it. It leaves out the lods
+	// chain, each level is prepared on its own
+	std::vector<OpenGLMesh> lods = std::move(meshInfo.lods);
+	optimized = meshInfo;
+	meshInfo.lods = std::move(lods);
+	optimized.geometryKey = key;
+	MeshOptimization result = OptimizeMesh(optimized, weldEpsilon);
+	std::cout << "INFO: Optimized \"" << key << "\": " << result.weld.verticesBefore << " -> " << result.weld.verticesAfter
+		<< " vertices (" << ((long long)result.weld.bytesBefore - (long long)result.weld.bytesAfter) << " bytes saved), ACMR "
+		<< result.before.acmr << " -> " << result.after.acmr << ", ATVR " << result.before.atvr << " -> " << result.after.atvr << std::endl;
+	return optimized;
+}
+
+void OpenGL::ClearScene() {
+
+	// give back every reference the scene holds, shared buffers go away with their last user
+	for (auto& meshID : meshIds) {
+		for (auto& level : meshID.lods) geometryCache.Release(level.geometry); // null for arena meshes, which is a no-op
+		if (meshID.texture != 0) textureCache.Release(meshID.texture);
+	}
+	for (auto& batch : instancedMeshIds) {
+		glDeleteVertexArrays(1, &batch.vao);
+		glDeleteBuffers(1, &batch.instanceBuffer);
+		geometryCache.Release(batch.geometry);
+		textureCache.Release(batch.texture);
+	}
+	meshIds.clear();
+	instancedMeshIds.clear();
+	movedShapes.clear();
+	settledShapes.clear();
+	if (multiDrawIndirect) meshArena.Clear();
+	simplifiedLods.clear();
+	indirectDirty = true;
+	sceneDirty = true;
+
+	// deleted names can be handed out again, so the state cache can no longer trust what it thinks is bound
+	glState.Invalidate();
+}
+
+GLuint OpenGL::AddTexture(const char* fileName) {
 
-	return textureId;
+	// repeated paths (and repeated images under other names) come back from the cache without decoding again
+	return textureCache.Acquire(fileName);
+}
+
+void OpenGL::ResolveTextures() {
+
+	// only runs on frames where a texture finished loading, swaps placeholders for the real thing
+	for (auto& meshID : meshIds) {
+		if (meshID.texture != 0) meshID.boundTexture = textureCache.Resolve(meshID.texture);
+	}
+	indirectDirty = true; // groups are split by texture
+	sceneDirty = true;
+	for (auto& batch : instancedMeshIds) {
+		batch.boundTexture = textureCache.Resolve(batch.texture);
+	}
 }
 
 void OpenGL::setProjection(bool orthogonal) {
 
+	glm::mat4 newProjection;
 	if (orthogonal) {
-		projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
+		newProjection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, NEAR_PLANE, FAR_PLANE);
 	}
 	else {
-		projection = glm::perspective(MainCamera.getFieldOfView(), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+		newProjection = glm::perspective(MainCamera.getFieldOfView(), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
 	}
+
+	// called every frame from input processing, only an actual switch needs a redraw
+	if (newProjection != projection) sceneDirty = true;
+	projection = newProjection;
 }
 
 bool OpenGL::RunScene() {
 
-	SetupLights();
+	geometryCache.printStats();
+	if (multiDrawIndirect) meshArena.printStats();
+
+	// offscreen frames are only ever wanted for timing, and nothing would wake the wait
+	bool onDemand = renderMode == RenderMode::ON_DEMAND && !headless;
+	bool animating = true; // the last frame's input changed something, so keep going without waiting (held keys send no events)
+
+	int frames = 0;
+	int idleWakeups = 0;
+	inputLatencies.clear();
+	framePacer.Reset();
+	simulationAccumulator = 0.0;
+	simulationSteps = 0;
+	if (recording != nullptr) {
+		recording->Begin(glfwGetTime());
+		CaptureInputState(recording->start);
+	}
+	latchInput = lateLatch;
+	double start = glfwGetTime();
 
 	while (!glfwWindowShouldClose(window)) {
 
-		frameTime.tick();
-		   Render();
-		frameTime.tock();
+		// fixed length runs (benchmarks, headless) stop on whichever limit comes first
+		if (maxFrames > 0 && frames >= maxFrames) break;
+		if (maxSeconds > 0.0 && glfwGetTime() - start >= maxSeconds) break;
+
+		// on demand, sleep until there is input (polling briefly while textures stream in), unless the last frame
+		// changed something: held keys send no events, so a moving camera has to keep polling
+		if (onDemand) {
+			if (animating) {
+				framePacer.WaitForNextFrame();
+				glfwPollEvents();
+			}
+			else glfwWaitEventsTimeout(textureCache.Loading() ? LOADING_WAIT_SECONDS : IDLE_WAIT_SECONDS);
+			ProcessInput();
+			if (textureCache.Pump()) ResolveTextures();
+
+			// skip the frame unless that input, or a finished texture, changed something, or the simulation is moving
+			animating = SceneChanged() || SimulationActive();
+			if (!animating) {
+				idleWakeups++;
+				pendingInputTime = 0.0; // nothing will show it, so there is no latency to measure
+				framePacer.Skip(); // the time asleep is not a frame
+				continue;
+			}
+		}
+		else framePacer.WaitForNextFrame(); // frame rate cap, before input so the wait does not age it
+
+		// whole interval since the last frame started, swap waits included, smoothed. It is what the simulation
+		// advances by (nothing right after an idle gap)
+		double elapsed = framePacer.Tick() ? framePacer.getDelta() : 0.0;
+		frames++;
+		profiler.BeginFrame();
+
+		// textures first, then input right before the frame is built so it is as fresh as possible
+		// (on demand both were just done to decide whether to render at all)
+		if (!onDemand) {
+			{
+				ProfileScope zone(profiler, "Textures");
+				if (textureCache.Pump()) ResolveTextures(); // uploads that are ready, within a per frame budget
+			}
+			{
+				ProfileScope zone(profiler, "Input");
+				glfwPollEvents(); // poll input and other
+				ProcessInput();
+			}
+		}
+
+		ClearChanges(); // this frame draws the current state
+		TakeInputTime();
+		{
+			ProfileScope zone(profiler, "Simulation");
+			if (recording != nullptr) recording->EndFrame(elapsed); // everything drained so far goes in before these steps
+			UpdateSimulation(elapsed);
+		}
+		Render();
+		profiler.EndFrame();
+	}
+	latchInput = false;
 
-		glfwPollEvents(); // poll input and other
-		ProcessMouseInput();
-		ProcessKeyboardInput();
+	// leave everything at its latest state for whatever renders next
+	InterpolateShapes(1.0f);
+	simulationAlpha = 1.0f;
+
+	double elapsed = glfwGetTime() - start;
+	if (frames > 0) {
+		std::cout << "INFO: " << frames << " frames in " << elapsed << " s, " << elapsed * 1000.0 / frames << " ms/frame, "
+			<< frames / elapsed << " fps" << (headless ? " (headless)" : "") << std::endl;
+	}
+	if (framePacer.getFrames() > 0) {
+		std::cout << "INFO: Frame interval mean " << framePacer.getMeanMs() << " ms, std dev " << framePacer.getStdDevMs()
+			<< " ms, worst " << framePacer.getWorstMs() << " ms" << std::endl;
+	}
+	if (simulationSteps > 0) {
+		std::cout << "INFO: " << simulationSteps << " simulation steps of " << SIMULATION_STEP * 1000.0f << " ms, "
+			<< (double)simulationSteps / std::max(frames, 1) << " per frame" << std::endl;
 	}
+	if (lodSwitches > 0) std::cout << "INFO: " << lodSwitches << " level of detail switches" << std::endl;
+	if (inputQueue.getDropped() > 0) std::cout << "INFO: " << inputQueue.getDropped() << " input events dropped, the queue was full" << std::endl;
+	if (onDemand) std::cout << "INFO: Rendered on demand, " << idleWakeups << " wakeups without a change" << std::endl;
+	if (!inputLatencies.empty()) {
+		TimingSummary latency = Summarize(inputLatencies);
+		std::cout << "INFO: Input to swap latency" << (lateLatch ? " (late latched)" : "") << ": mean " << latency.mean
+			<< " ms, p99 " << latency.p99 << " ms over " << inputLatencies.size() << " frames with input" << std::endl;
+	}
+	glState.printStats();
 	return true;
 }
 
-void OpenGL::SetupLights() {
+double OpenGL::RunFrames(int frames) {
+
+	// as fast as the GPU goes, with the queue drained before and after so only these frames are timed
+	// (no keyboard processing here, which is where the projection is normally set)
+	setProjection(PERSPECTIVE);
+	glfwSwapInterval(0);
+	glFinish();
+	double start = glfwGetTime();
+
+	int rendered = 0;
+	for (; rendered < frames && !glfwWindowShouldClose(window); rendered++) {
+		profiler.BeginFrame();
+		if (textureCache.Pump()) ResolveTextures();
+		Render();
+		glfwPollEvents();
+		ProcessInput(false); // keeps key and cursor state current, nothing is applied
+		profiler.EndFrame();
+	}
 
-	GLuint shaderProgramID = textureShader; //color shader has no lighting or just ambient lights
-	glUseProgram(shaderProgramID); // set openGL to use our linked shader program
+	glFinish();
+	double elapsed = glfwGetTime() - start;
+	ApplySwapMode();
+	return (rendered > 0) ? elapsed * 1000.0 / rendered : 0.0;
+}
 
-	// get locations
-	GLint lightColorLoc1 = glGetUniformLocation(shaderProgramID, "lightColor1");
-	GLint lightPositionLoc1 = glGetUniformLocation(shaderProgramID, "lightPos1");
-	GLint lightStrengthLoc1 = glGetUniformLocation(shaderProgramID, "lightStrength1");
-	GLint lightColorLoc2 = glGetUniformLocation(shaderProgramID, "lightColor2");
-	GLint lightPositionLoc2 = glGetUniformLocation(shaderProgramID, "lightPos2");
-	GLint lightStrengthLoc2 = glGetUniformLocation(shaderProgramID, "lightStrength2");
+void OpenGL::WaitForTextures() {
+
+	// textures streaming in would be timed too, so keep rendering until they are all resident
+	setProjection(PERSPECTIVE);
+	while (textureCache.Loading() && !glfwWindowShouldClose(window)) {
+		profiler.BeginFrame();
+		if (textureCache.Pump()) ResolveTextures();
+		Render();
+		glfwPollEvents();
+		ProcessInput(false); // keeps key and cursor state current, nothing is applied
+		profiler.EndFrame();
+	}
+}
 
-	// handle lighting information
-	if (mLightingArray.size() < 1) {
-		// let pass for now. Could throw an exception too "no lights no lights".
+void OpenGL::BenchmarkVertexShader(int frames) {
+
+	WaitForTextures();
+
+	double cpuNormalMs = RunFrames(frames);
+	long long triangles = renderStats.triangles;
+
+	// the same scene again with the old shaders that rebuild the normal matrix for every vertex, on every path
+	// that draws textured shapes: single draws, instanced batches and the arena. Packed shapes keep theirs,
+	// their model matrix includes the bounds decode so inverting it per vertex would not give their normals
+	struct ProgramSwap {
+		GLuint* shader;
+		ShaderUniforms* uniforms;
+		const char* vertexSource;
+		GLuint saved;
+		ShaderUniforms savedUniforms;
+	};
+	std::vector<ProgramSwap> swaps = {
+		{ &textureShader, &textureUniforms, perVertexNormalShaderSource },
+		{ &instancedTextureShader, &instancedUniforms, perVertexNormalInstancedShaderSource } };
+	if (multiDrawIndirect) swaps.push_back({ &indirectShader, &indirectUniforms, perVertexNormalIndirectShaderSource });
+
+	for (auto& swap : swaps) {
+		swap.saved = *swap.shader;
+		swap.savedUniforms = *swap.uniforms;
+		*swap.shader = BuildShaderProgram(swap.vertexSource, textureShaderSource);
+		*swap.uniforms = ResolveUniforms(*swap.shader);
+		glState.UseProgram(*swap.shader);
+		swap.uniforms->texture.set(0);
 	}
-	if (mLightingArray.size() >= 1) { // add actual data
-		// attach
-		glUniform3f(lightColorLoc1, mLightingArray.at(0).R, mLightingArray.at(0).G, mLightingArray.at(0).B);
-		glUniform3f(lightPositionLoc1, mLightingArray.at(0).X, mLightingArray.at(0).Y, mLightingArray.at(0).Z);
-		glUniform1f(lightStrengthLoc1, mLightingArray.at(0).getIntensity());
+
+	double gpuNormalMs = RunFrames(frames);
+
+	for (auto& swap : swaps) {
+		glDeleteProgram(*swap.shader);
+		mUniformTables.erase(*swap.shader);
+		*swap.shader = swap.saved;
+		*swap.uniforms = swap.savedUniforms;
 	}
-	else { // add a light that is "off"
-			// more efficient to create multiple shaders but this is fine for small scenes
-		glUniform3f(lightColorLoc1, 1.0f, 1.0f, 1.0f);
-		glUniform3f(lightPositionLoc1, 0.0f, 0.0f, 0.0f);
-		glUniform1f(lightStrengthLoc1, 0.0f);
+	glState.Invalidate(); // the deleted programs may still be current
+
+	auto trianglesPerSecond = [triangles](double ms) { return (ms > 0.0) ? triangles / ms / 1000.0 : 0.0; };
+	std::cout << "INFO: Vertex benchmark, " << triangles << " triangles per frame over " << frames << " frames (textured draws, "
+		<< "instanced batches" << (multiDrawIndirect ? " and multi-draw indirect" : "") << (packedVertices ? ", packed shapes not swapped" : "")
+		<< ")" << std::endl;
+	std::cout << "INFO:   normal matrix per object (CPU): " << cpuNormalMs << " ms/frame, "
+		<< trianglesPerSecond(cpuNormalMs) << " M triangles/s" << std::endl;
+	std::cout << "INFO:   normal matrix per vertex (GPU): " << gpuNormalMs << " ms/frame, "
+		<< trianglesPerSecond(gpuNormalMs) << " M triangles/s" << std::endl;
+}
+
+FrameTimings OpenGL::RunCameraPath(const CameraPath& path, const std::string& scene, float timestep, int frames) {
+
+	// simulated time, not wall time: the camera is in the same place on frame N of every run
+	return TimeFrames("Camera path", scene, timestep, frames, true, [&](int frame) {
+		CameraKey key = path.Sample(frame * timestep);
+		MainCamera.lookAt(key.position, key.target);
+	});
+}
+
+FrameTimings OpenGL::RunReplay(const InputRecording& session, const std::string& scene) {
+
+	// same starting point, then each frame gets its recorded events and advances the simulation by its recorded
+	// time, so it runs the same steps with the same input as the session did
+	DiscardInput();
+	RestoreInputState(session.start);
+	simulationAccumulator = 0.0;
+	simulationSteps = 0;
+
+	// the session ended with escape, the replay should not end the program halfway through timing it
+	auto withoutClose = [](std::vector<InputEvent> events) {
+		events.erase(std::remove_if(events.begin(), events.end(), [](const InputEvent& event) {
+			return event.type == InputEventType::KEY && event.key == GLFW_KEY_ESCAPE;
+		}), events.end());
+		return events;
+	};
+
+	FrameTimings timings = TimeFrames("Replay", scene, SIMULATION_STEP, (int)session.frames.size(), false, [&](int frame) {
+		const RecordedFrame& recorded = session.frames[frame];
+		ApplyInput(withoutClose(recorded.events), true);
+		UpdateSimulation(recorded.elapsed);
+		ApplyInput(withoutClose(recorded.latched), true); // where the late latch applied them
+		pendingInputTime = 0.0; // recorded events are not live input, there is no latency to measure
+	});
+
+	// live input starts over from nothing held
+	std::fill(std::begin(keysDown), std::end(keysDown), false);
+	cursorSeen = false;
+	heldDirections.clear();
+	return timings;
+}
+
+FrameTimings OpenGL::TimeFrames(const char* label, const std::string& scene, float timestep, int frames, bool liveInput,
+	const std::function<void(int)>& advance) {
+
+	FrameTimings timings;
+	timings.scene = scene;
+	timings.timestep = timestep;
+
+	WaitForTextures();
+	glfwSwapInterval(0);
+
+	// this has its own query around DrawFrame, and GL_TIME_ELAPSED queries cannot nest
+	bool profiling = profiler.isEnabled();
+	profiler.SetEnabled(false);
+
+	// GPU times come back a few frames late, reading them right away would stall on the GPU
+	const int QUERY_LATENCY = 4;
+	GLuint queries[QUERY_LATENCY];
+	glCreateQueries(GL_TIME_ELAPSED, QUERY_LATENCY, queries);
+	auto collect = [&](int frame) {
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v(queries[frame % QUERY_LATENCY], GL_QUERY_RESULT, &elapsedNs);
+		timings.gpuMs.push_back(elapsedNs / 1.0e6);
+	};
+
+	int frame = 0;
+	for (; frame < frames && !glfwWindowShouldClose(window); frame++) {
+
+		double frameStart = glfwGetTime();
+		advance(frame);
+		glBeginQuery(GL_TIME_ELAPSED, queries[frame % QUERY_LATENCY]);
+		DrawFrame();
+		glEndQuery(GL_TIME_ELAPSED);
+		double submitted = glfwGetTime();
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+		if (liveInput) ProcessInput(false); // keeps key and cursor state current, nothing is applied
+		else DiscardInput();
+		double frameEnd = glfwGetTime();
+
+		timings.cpuMs.push_back((submitted - frameStart) * 1000.0);
+		timings.frameMs.push_back((frameEnd - frameStart) * 1000.0);
+		if (frame >= QUERY_LATENCY - 1) collect(frame - (QUERY_LATENCY - 1));
 	}
-	if (mLightingArray.size() >= 2) {
-		glUniform3f(lightColorLoc2, mLightingArray.at(1).R, mLightingArray.at(1).G, mLightingArray.at(1).B);
-		glUniform3f(lightPositionLoc2, mLightingArray.at(1).X, mLightingArray.at(1).Y, mLightingArray.at(1).Z);
-		glUniform1f(lightStrengthLoc2, mLightingArray.at(1).getIntensity());
+
+	// the last few queries
+	for (int pending = std::max(0, frame - (QUERY_LATENCY - 1)); pending < frame; pending++) collect(pending);
+	glDeleteQueries(QUERY_LATENCY, queries);
+	ApplySwapMode();
+	profiler.SetEnabled(profiling);
+
+	timings.triangles = renderStats.triangles;
+	timings.drawCalls = renderStats.drawCalls;
+
+	TimingSummary frameSummary = Summarize(timings.frameMs);
+	std::cout << "INFO: " << label << " \"" << scene << "\": " << frame << " frames, mean " << frameSummary.mean << " ms, p99 "
+		<< frameSummary.p99 << " ms, worst " << frameSummary.worst << " ms (frame " << frameSummary.worstFrame << ")" << std::endl;
+	return timings;
+}
+
+void OpenGL::UpdateSharedUniforms() {
+
+	// build both blocks from current state every frame, the buffers only upload when something differs
+	FrameBlock frame;
+	frame.view = view;
+	frame.projection = projection;
+	frame.viewPosition = glm::vec4(MainCamera.getPosition(simulationAlpha), 1.0f);
+	if (!lateLatch) frameUniformBuffer.Update(&frame, sizeof(frame)); // late latched, it is written right before the draws
+
+	LightBlock lights = {};
+	lights.count = (GLint)mLightingArray.size(); // no lights just means ambient only
+	for (int i = 0; i < lights.count; i++) {
+		Light& light = mLightingArray.at(i);
+		lights.position[i] = glm::vec4(light.getPosition(), light.getIntensity());
+		lights.color[i] = glm::vec4(light.getColor(), 1.0f);
 	}
-	else {
-		glUniform3f(lightColorLoc2, 1.0f, 1.0f, 1.0f);
-		glUniform3f(lightPositionLoc2, 0.0f, 0.0f, 0.0f);
-		glUniform1f(lightStrengthLoc2, 0.0f);
+	lightUniformBuffer.Update(&lights, sizeof(lights));
+
+	// no rebinding: the blocks were attached to their binding points at Create and nothing else uses those points
+}
+
+void OpenGL::Render() {
+
+	double renderStart = glfwGetTime();
+	float frameMs = (lastRenderStart > 0.0) ? (float)((renderStart - lastRenderStart) * 1000.0) : 0.0f;
+	lastRenderStart = renderStart;
+
+	// GPU time is only measured while someone is looking at it (read once, the late latch can toggle it mid frame)
+	bool showHud = hudVisible;
+	if (showHud) gpuFrameTimer.Begin();
+	DrawFrame();
+	if (showHud) gpuFrameTimer.End();
+
+	renderStats.cpuMs = (glfwGetTime() - renderStart) * 1000.0;
+	renderStats.gpuMs = showHud ? gpuFrameTimer.getLastMs() : 0.0;
+
+	// overlay pass on top of the finished scene
+	if (showHud) {
+		hud.AddFrame(frameMs, (float)renderStats.cpuMs, (float)renderStats.gpuMs);
+		DrawHud();
 	}
-	if (mLightingArray.size() >= 3) {
-		// not supported actually
+
+	{
+		ProfileScope zone(profiler, "Swap");
+		glfwSwapBuffers(window); // send this frame to window and move active window information back
 	}
 
+	// from the oldest input this frame shows until it was handed to the display
+	if (frameInputTime > 0.0) {
+		renderStats.inputLatencyMs = (glfwGetTime() - frameInputTime) * 1000.0;
+		if (inputLatencies.size() < MAX_LATENCY_SAMPLES) inputLatencies.push_back(renderStats.inputLatencyMs);
+		frameInputTime = 0.0;
+	}
 }
 
-void OpenGL::Render() {
+void OpenGL::DrawFrame() {
 
-	glEnable(GL_DEPTH_TEST); // automatically resolve pixel color based on depth
+	ProfileScope zone(profiler, "Draw");
+	profiler.BeginGpuZone("Scene pass");
+
+	glState.BeginFrame();
+	if (viewportPending) {
+		glViewport(0, 0, viewportWidth, viewportHeight);
+		viewportPending = false;
+	}
+	glState.Enable(GL_DEPTH_TEST); // automatically resolve pixel color based on depth (only issued the first frame)
+	glState.Disable(GL_BLEND); // left on by the HUD
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //clear screen
 
 	// get the camera view for this frame
-	view = MainCamera.getView();
-
-	for (auto meshID : meshIds) { //for each created and registered mesh, which has its own VAO
-
-		bool isTextured = (meshID.texture != 0) ? true : false;
-		GLuint shaderProgramID = isTextured ? textureShader : colorShader;
-
-		
-		glUseProgram(shaderProgramID); // set openGL to use our linked shader program
-		glUniform1i(glGetUniformLocation(shaderProgramID, "uTexture"), 0);
-
-		// Retrieves and passes transform matrices to the shader program
-		GLint modelLoc = glGetUniformLocation(shaderProgramID, "model");
-		GLint viewLoc = glGetUniformLocation(shaderProgramID, "view");
-		GLint projLoc = glGetUniformLocation(shaderProgramID, "projection");
-		GLint rotationLoc = glGetUniformLocation(shaderProgramID, "rotation");
-		GLint shinyLoc = glGetUniformLocation(shaderProgramID, "shininess");
-		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(meshID.model)); //each mesh has its own model, and uses the general view and P
-		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-		glUniformMatrix4fv(rotationLoc, 1, GL_FALSE, glm::value_ptr(meshID.rotation)); // we will rotate the normals in the shader
-		glUniform1f(shinyLoc, meshID.shininess);
-
-		// attach extra information for speculars
-		GLint objectColorLoc = glGetUniformLocation(shaderProgramID, "objectColor");
-		GLint viewPositionLoc = glGetUniformLocation(shaderProgramID, "viewPosition");
-		glUniform3f(viewPositionLoc, MainCamera.mCameraPosition.x, MainCamera.mCameraPosition.y, MainCamera.mCameraPosition.z);
-
-		if (isTextured) {
-			glUniform1i(glGetUniformLocation(shaderProgramID, "uTexture"), 0);
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, meshID.texture);
+	{
+		ProfileScope zone(profiler, "Uniforms");
+		view = MainCamera.getView(simulationAlpha);
+		UpdateSharedUniforms();
+	}
+
+	// sort this frame's draws by state, then draw them changing only what differs from the previous draw
+	{
+		ProfileScope zone(profiler, "Build queue");
+		BuildRenderQueue();
+	}
+	{
+		ProfileScope zone(profiler, "Submit");
+		if (lateLatch) LatchView();
+		SubmitRenderQueue();
+		if (lateLatch) frameRing.Fence();
+	}
+
+	profiler.EndGpuZone();
+}
+
+void OpenGL::UpdateSimulation(double elapsed) {
+
+	// as many whole steps as the elapsed time covers, the remainder carries over to the next frame
+	simulationAccumulator += elapsed;
+	int steps = 0;
+	while (simulationAccumulator >= SIMULATION_STEP && steps < MAX_STEPS_PER_FRAME) {
+		StepSimulation(SIMULATION_STEP);
+		simulationAccumulator -= SIMULATION_STEP;
+		steps++;
+	}
+	if (steps == MAX_STEPS_PER_FRAME) simulationAccumulator = std::fmod(simulationAccumulator, (double)SIMULATION_STEP);
+
+	// the frame shows the state this far between the last step and the one after it
+	simulationAlpha = (float)(simulationAccumulator / SIMULATION_STEP);
+	InterpolateShapes(simulationAlpha);
+}
+
+void OpenGL::StepSimulation(float step) {
+
+	// whatever moved in the last step starts this one where that step left it
+	for (int shape : movedShapes) {
+		meshID& mesh = meshIds[shape];
+		mesh.previous = mesh.current;
+		mesh.moved = false;
+		settledShapes.push_back(shape);
+	}
+	movedShapes.clear();
+	MainCamera.beginStep();
+
+	simulating = true;
+	for (CameraDirection direction : heldDirections) MainCamera.move(direction, step);
+	if (updateCallback) updateCallback(*this, step);
+	simulating = false;
+	simulationSteps++;
+}
+
+void OpenGL::InterpolateShapes(float alpha) {
+
+	// shapes that stopped go to where they ended, then the ones still moving are blended
+	for (int shape : settledShapes) {
+		meshID& mesh = meshIds[shape];
+		mesh.setModel(mesh.current.model());
+		if (mesh.inArena) indirectDirty = true;
+	}
+	settledShapes.clear();
+
+	for (int shape : movedShapes) {
+		meshID& mesh = meshIds[shape];
+		mesh.setModel(MeshTransform::Mix(mesh.previous, mesh.current, alpha).model());
+		if (mesh.inArena) indirectDirty = true;
+	}
+}
+
+bool OpenGL::SimulationActive() {
+	return !heldDirections.empty() || !movedShapes.empty() || !settledShapes.empty()
+		|| MainCamera.mPreviousPosition != MainCamera.mCameraPosition;
+}
+
+void OpenGL::LatchView() {
+
+	// one more look at the mouse now that the draws are sorted, the view written here is the one they use
+	if (latchInput) {
+		glfwPollEvents();
+		DrainInput();
+		if (recording != nullptr) {
+			for (auto& drained : drainedEvents) recording->AddLatchedEvent(drained); // this frame, after its steps
+		}
+		ApplyInput(drainedEvents, true);
+		TakeInputTime();
+	}
+	view = MainCamera.getView(simulationAlpha);
+
+	FrameBlock* frame = (FrameBlock*)frameRing.Next();
+	frame->view = view;
+	frame->projection = projection;
+	frame->viewPosition = glm::vec4(MainCamera.getPosition(simulationAlpha), 1.0f);
+	frameRing.Bind();
+}
+
+void OpenGL::DrawHud() {
+
+	ProfileScope zone(profiler, "HUD");
+	profiler.BeginGpuZone("HUD pass");
+
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	if (headless) { width = WINDOW_WIDTH; height = WINDOW_HEIGHT; }
+	hud.Begin(width, height);
+
+	const uint32_t white = Hud::Color(235, 235, 235);
+	const uint32_t cpuColor = Hud::Color(90, 200, 90);
+	const uint32_t gpuColor = Hud::Color(230, 150, 50);
+	const float x = 12.0f;
+	const float graphWidth = 360.0f;
+	const float graphHeight = 40.0f;
+	float y = 12.0f;
+	float line = hud.getLineHeight();
+	char text[128];
+
+	hud.Rect(6.0f, 6.0f, graphWidth + 12.0f, line * 9 + graphHeight * 2 + 22.0f, Hud::Color(0, 0, 0, 160));
+
+	float frameMs = hud.Average(0);
+	snprintf(text, sizeof(text), "%.1f FPS  %.2f ms  sd %.2f", frameMs > 0.0f ? 1000.0f / frameMs : 0.0f, frameMs,
+		hud.Deviation(0));
+	hud.Text(x, y, text, white);
+	y += line;
+	snprintf(text, sizeof(text), "input to swap %.1f ms", renderStats.inputLatencyMs);
+	hud.Text(x, y, text, white);
+	y += line;
+
+	// frame time graphs, full scale is 33 ms (30 fps)
+	snprintf(text, sizeof(text), "CPU %.2f ms", hud.Average(1));
+	hud.Text(x, y, text, cpuColor);
+	y += line;
+	hud.Graph(x, y, graphWidth, graphHeight, 1, 33.3f, cpuColor);
+	y += graphHeight + 4.0f;
+	snprintf(text, sizeof(text), "GPU %.2f ms", hud.Average(2));
+	hud.Text(x, y, text, gpuColor);
+	y += line;
+	hud.Graph(x, y, graphWidth, graphHeight, 2, 33.3f, gpuColor);
+	y += graphHeight + 4.0f;
+
+	const RenderStats& stats = renderStats;
+	snprintf(text, sizeof(text), "draws %d  objects %d  tris %.1fk", stats.drawCalls, stats.instances, stats.triangles / 1000.0);
+	hud.Text(x, y, text, white);
+	y += line;
+	snprintf(text, sizeof(text), "state changes %d  skipped %d", stats.stateChanges(), stats.glCallsSkipped);
+	hud.Text(x, y, text, white);
+	y += line;
+
+	double textureMB = textureCache.getResidentBytes() / (1024.0 * 1024.0);
+	double bufferMB = (geometryCache.getResidentBytes() + (multiDrawIndirect ? meshArena.getBytesUsed() : 0)) / (1024.0 * 1024.0);
+	snprintf(text, sizeof(text), "textures %.1f MB  buffers %.1f MB", textureMB, bufferMB);
+	hud.Text(x, y, text, white);
+	y += line;
+
+	snprintf(text, sizeof(text), "%s%s  %s%s", multiDrawIndirect ? "multi-draw indirect" : "sorted queue",
+		instancedMeshIds.empty() ? "" : " + instancing", orthographic ? "ortho" : "perspective",
+		headless ? "  headless" : "");
+	hud.Text(x, y, text, white);
+	y += line;
+	hud.Text(x, y, "H hides this", Hud::Color(150, 150, 150));
+
+	hud.Draw(glState);
+	profiler.EndGpuZone();
+}
+
+void OpenGL::BuildRenderQueue() {
+
+	renderQueue.Clear();
+
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	if (headless) { width = WINDOW_WIDTH; height = WINDOW_HEIGHT; }
+
+	for (uint32_t i = 0; i < meshIds.size(); i++) {
+
+		meshID& mesh = meshIds[i];
+
+		// a level change moves the shape to other geometry, for the arena that means other draw commands
+		if (mesh.lods.size() > 1 && SelectLod(mesh, (float)height) && mesh.inArena) indirectDirty = true;
+		if (mesh.inArena) continue; // drawn by SubmitIndirectDraws
+		GLuint shaderProgramID = (mesh.texture != 0) ? (mesh.packed ? packedTextureShader : textureShader) : colorShader;
+
+		// distance of the object origin along the view direction, as a fraction of the far plane
+		glm::vec4 viewSpace = view * mesh.model[3];
+		float depth = -viewSpace.z / FAR_PLANE;
+
+		renderQueue.Push(RenderQueue::MakeKey(shaderProgramID, mesh.boundTexture, mesh.vao, depth), i);
+	}
+
+	// batches cover many positions at once, so they only sort by state
+	for (uint32_t i = 0; i < instancedMeshIds.size(); i++) {
+		instancedMeshID& batch = instancedMeshIds[i];
+		renderQueue.Push(RenderQueue::MakeKey(instancedTextureShader, batch.boundTexture, batch.vao, 0.0f), i | INSTANCED_DRAW);
+	}
+
+	renderQueue.Sort();
+}
+
+void OpenGL::SubmitRenderQueue() {
+
+	RenderStats stats;
+
+	// whatever the previous frame left bound is still bound, the state cache knows what that was
+	const ShaderUniforms* uniforms = nullptr;
+
+	for (auto& item : renderQueue.Items()) {
+
+		bool instanced = (item.index & INSTANCED_DRAW) != 0;
+		uint32_t index = item.index & ~INSTANCED_DRAW;
+
+		GLuint shaderProgramID, texture, vao;
+		if (instanced) {
+			instancedMeshID& batch = instancedMeshIds[index];
+			shaderProgramID = instancedTextureShader;
+			texture = batch.boundTexture;
+			vao = batch.vao;
+		}
+		else {
+			meshID& mesh = meshIds[index];
+			shaderProgramID = (mesh.texture != 0) ? (mesh.packed ? packedTextureShader : textureShader) : colorShader;
+			texture = mesh.boundTexture;
+			vao = mesh.vao;
+		}
+
+		// only touch state that differs from the previous draw
+		if (shaderProgramID == textureShader) uniforms = &textureUniforms;
+		else if (shaderProgramID == instancedTextureShader) uniforms = &instancedUniforms;
+		else if (shaderProgramID == packedTextureShader) uniforms = &packedUniforms;
+		else uniforms = &colorUniforms;
+		if (glState.UseProgram(shaderProgramID)) stats.programChanges++; // set openGL to use our linked shader program
+		if (texture != 0 && glState.BindTexture(0, texture)) stats.textureChanges++;
+		if (glState.BindVertexArray(vao)) stats.vaoChanges++; // set openGL to use our mesh array (it was registered in the library at creation)
+
+		if (instanced) {
+			instancedMeshID& batch = instancedMeshIds[index];
+			glDrawElementsInstanced(GL_TRIANGLES, batch.nIndices, batch.indexType, NULL, batch.nInstances);
+			stats.instances += batch.nInstances;
+			stats.triangles += (long long)batch.nIndices / 3 * batch.nInstances;
+		}
+		else {
+			meshID& mesh = meshIds[index];
+
+			// passes transform matrices to the shader program through the cached handles
+			uniforms->model.set(mesh.packed ? mesh.model * mesh.decode : mesh.model); //each mesh has its own model, view and P come from the frame block
+			uniforms->normalMatrix.set(mesh.normalMatrix); // precomputed, the shader no longer inverts per vertex
+			uniforms->shininess.set(mesh.shininess);
+
+			glDrawElements(GL_TRIANGLES, mesh.nIndices, mesh.indexType, NULL); // DRAW (as triangles)
+			stats.instances++;
+			stats.triangles += mesh.nIndices / 3;
 		}
+		stats.drawCalls++;
+	}
 
-		glBindVertexArray(meshID.vao); // set openGL to use our mesh array (it was registered in the library at creation)
-		glDrawElements(GL_TRIANGLES, meshID.nIndices, GL_UNSIGNED_SHORT, NULL); // DRAW (as triangles)
-		glBindVertexArray(0); // unset this VAO
+	if (multiDrawIndirect) SubmitIndirectDraws(stats);
+
+	// nothing is unbound at the end, the next frame usually starts with the same state
+	stats.glCallsIssued = glState.getIssuedCalls();
+	stats.glCallsSkipped = glState.getSkippedCalls();
+	renderStats = stats;
+}
 
-		glBindTexture(GL_TEXTURE_2D, 0);
-		
+// grow-only upload for buffers whose size changes with the scene
+static void UploadDynamic(GLuint buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size) {
+	if (size == 0) return;
+	if (size > capacity) {
+		capacity = std::max(size, capacity * 2);
+		glNamedBufferData(buffer, capacity, NULL, GL_DYNAMIC_DRAW); // same name, so existing bindings stay valid
 	}
-	glfwSwapBuffers(window); // send this frame to window and move active window information back
+	glNamedBufferSubData(buffer, 0, size, data);
 }
 
+void OpenGL::BuildIndirectDraws() {
 
-void OpenGL::ProcessMouseInput() {
-	// the static variables for movement are updated in the callback routine for mouse movement
-	// so now we have to make sure that we process the new movement ourselves
-	if (Callbacks::mouseMovement) {
-		MainCamera.rotate(Callbacks::xMouseMovement, Callbacks::yMouseMovement);
-		Callbacks::mouseMovement = false; 
+	indirectDirty = false;
+	indirectGroups.clear();
+	drawRecords.clear();
+	indirectCommands.clear();
+	indirectTriangles = 0;
+
+	// group by layout and index type, then texture (without bindless textures each texture still needs its own draw)
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < meshIds.size(); i++) {
+		if (meshIds[i].inArena) order.push_back(i);
 	}
-	if (Callbacks::mouseScrolling) {
-		MainCamera.changeMovementSpeed(Callbacks::scale);
-		Callbacks::mouseScrolling = false;
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		const meshID& left = meshIds[a];
+		const meshID& right = meshIds[b];
+		if (left.vao != right.vao) return left.vao < right.vao;
+		if (left.indexType != right.indexType) return left.indexType < right.indexType;
+		return left.boundTexture < right.boundTexture;
+	});
+
+	for (uint32_t index : order) {
+
+		const meshID& mesh = meshIds[index];
+		if (indirectGroups.empty() || indirectGroups.back().vao != mesh.vao || indirectGroups.back().indexType != mesh.indexType
+			|| indirectGroups.back().texture != mesh.boundTexture) {
+			indirectGroups.push_back({ mesh.vao, mesh.indexType, mesh.boundTexture, (GLsizei)indirectCommands.size(), 0 });
+		}
+
+		GLuint record = (GLuint)drawRecords.size();
+		drawRecords.push_back({ mesh.model, glm::mat4(mesh.normalMatrix), glm::vec4(mesh.shininess, 0.0f, 0.0f, 0.0f) });
+		indirectCommands.push_back({ mesh.arena.nIndices, 1, mesh.arena.firstIndex, mesh.arena.baseVertex, record });
+		indirectGroups.back().commandCount++;
+		indirectTriangles += mesh.arena.nIndices / 3;
 	}
+
+	meshArena.ReserveDraws((GLuint)drawRecords.size());
+	UploadDynamic(drawRecordBuffer, drawRecordCapacity, drawRecords.data(), sizeof(DrawRecord) * drawRecords.size());
+	UploadDynamic(indirectBuffer, indirectCapacity, indirectCommands.data(), sizeof(IndirectCommand) * indirectCommands.size());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BLOCK_BINDING, drawRecordBuffer);
 }
 
-void OpenGL::ProcessKeyboardInput() {
+void OpenGL::SubmitIndirectDraws(RenderStats& stats) {
 
-	// ESC
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-		glfwSetWindowShouldClose(window, true);
-		return;
+	if (indirectDirty) BuildIndirectDraws();
+	if (indirectGroups.empty()) return;
+
+	// the per frame cost is the number of groups, not the number of meshes
+	if (glState.UseProgram(indirectShader)) stats.programChanges++;
+	glState.BindIndirectBuffer(indirectBuffer);
+	for (auto& group : indirectGroups) {
+		if (glState.BindTexture(0, group.texture)) stats.textureChanges++;
+		if (glState.BindVertexArray(group.vao)) stats.vaoChanges++;
+		glMultiDrawElementsIndirect(GL_TRIANGLES, group.indexType,
+			(void*)(sizeof(IndirectCommand) * group.firstCommand), group.commandCount, 0);
+		stats.drawCalls++;
 	}
+	stats.instances += (int)drawRecords.size();
+	stats.triangles += indirectTriangles;
+}
+
+void OpenGL::DrainInput() {
+	drainedEvents.clear();
+	InputEvent event;
+	while (inputQueue.Pop(event)) drainedEvents.push_back(event);
+}
 
-	// CAMERA DIRECTIONALS
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		MainCamera.move(CameraDirection::FORWARD, frameTime.lastFrame);
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		MainCamera.move(CameraDirection::BACK, frameTime.lastFrame);
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		MainCamera.move(CameraDirection::LEFT, frameTime.lastFrame);
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		MainCamera.move(CameraDirection::RIGHT, frameTime.lastFrame);
-	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-		MainCamera.move(CameraDirection::UP, frameTime.lastFrame);
-	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		MainCamera.move(CameraDirection::DOWN, frameTime.lastFrame);
+void OpenGL::ProcessInput(bool apply) {
 
-	// P
-	if (Callbacks::keyP_Toggle) setProjection(ORTHO);
-	else setProjection(PERSPECTIVE);
+	DrainInput();
+	if (apply && recording != nullptr) {
+		for (auto& drained : drainedEvents) recording->AddEvent(drained);
+	}
+	ApplyInput(drainedEvents, apply);
 }
 
+void OpenGL::DiscardInput() {
+	InputEvent event;
+	while (inputQueue.Pop(event)) {}
+}
 
-/* GLFW :: Callbacks -----------------------------------------------------------------------------------*/
+void OpenGL::ApplyInput(const std::vector<InputEvent>& events, bool apply) {
+
+	// every event since the last drain, in order. Cursor movement is summed so none of it is lost however many
+	// events came in, keys keep their up/down state
+	float xMovement = 0.0f;
+	float yMovement = 0.0f;
+	for (const InputEvent& event : events) {
+
+		if (apply && pendingInputTime == 0.0) pendingInputTime = event.time;
+
+		switch (event.type) {
+
+			case InputEventType::CURSOR:
+				if (cursorSeen) {
+					xMovement += event.x - cursorX;
+					yMovement += cursorY - event.y;
+				}
+				cursorSeen = true;
+				cursorX = event.x;
+				cursorY = event.y;
+				break;
+
+			case InputEventType::SCROLL:
+				if (apply) MainCamera.changeMovementSpeed(event.y);
+				break;
+
+			case InputEventType::KEY:
+				if (event.key >= 0 && event.key <= GLFW_KEY_LAST) keysDown[event.key] = event.action != GLFW_RELEASE;
+				if (!apply || event.action != GLFW_PRESS) break;
+				if (event.key == GLFW_KEY_ESCAPE) glfwSetWindowShouldClose(window, true);
+				if (event.key == GLFW_KEY_P) orthographic = !orthographic;
+				if (event.key == GLFW_KEY_H) ShowHud(!hudVisible);
+				break;
+
+			case InputEventType::RESIZE:
+				viewportPending = true; // DrawFrame applies it
+				viewportWidth = (int)event.x;
+				viewportHeight = (int)event.y;
+				sceneDirty = true;
+				break;
+
+			case InputEventType::REFRESH:
+				sceneDirty = true;
+				break;
+		}
+	}
+	if (!apply) return;
 
-// GLFW: whenever the window size changed (by OS or user resize) this callback function executes
-void OpenGL::Callbacks::_resizeWindow(GLFWwindow* window, int width, int height)
-{
-	glViewport(0, 0, width, height);
-}
-
-// mouse tracking
-bool OpenGL::Callbacks::firstMouseMovement = true;
-bool OpenGL::Callbacks::mouseMovement = false;
-float OpenGL::Callbacks::mouseLastX;
-float OpenGL::Callbacks::mouseLastY;
-float OpenGL::Callbacks::xMouseMovement;
-float OpenGL::Callbacks::yMouseMovement;
-void OpenGL::Callbacks::_mousePosition(GLFWwindow* window, double xpos, double ypos) {
+	if (xMovement != 0.0f || yMovement != 0.0f) MainCamera.rotate(xMovement, yMovement);
+
+	// CAMERA DIRECTIONALS, applied by the simulation steps
+	heldDirections.clear();
+	if (keysDown[GLFW_KEY_W]) heldDirections.push_back(CameraDirection::FORWARD);
+	if (keysDown[GLFW_KEY_S]) heldDirections.push_back(CameraDirection::BACK);
+	if (keysDown[GLFW_KEY_A]) heldDirections.push_back(CameraDirection::LEFT);
+	if (keysDown[GLFW_KEY_D]) heldDirections.push_back(CameraDirection::RIGHT);
+	if (keysDown[GLFW_KEY_Q]) heldDirections.push_back(CameraDirection::UP);
+	if (keysDown[GLFW_KEY_E]) heldDirections.push_back(CameraDirection::DOWN);
+
+	// a held key sends no more events, so this drain is its input time
+	if (!heldDirections.empty() && pendingInputTime == 0.0) pendingInputTime = glfwGetTime();
+
+	setProjection(orthographic ? ORTHO : PERSPECTIVE);
+}
 
-	// set the initial position the first time the mouse is moved
-	if (firstMouseMovement) {
-		mouseLastX = xpos;
-		mouseLastY = ypos;
-		firstMouseMovement = false;
+void OpenGL::CaptureInputState(RecordingStart& start) {
+
+	start.cameraPosition = MainCamera.mCameraPosition;
+	start.cameraPointsAt = MainCamera.mCameraPointsAt;
+	start.rotationX = MainCamera.mRotationX;
+	start.rotationY = MainCamera.mRotationY;
+	start.panSpeed = MainCamera.mPanSpeed;
+	start.rotateSpeed = MainCamera.mRotateSpeed;
+	start.fieldOfView = MainCamera.mFieldOfView;
+	start.cursorSeen = cursorSeen;
+	start.cursorX = cursorX;
+	start.cursorY = cursorY;
+	start.orthographic = orthographic;
+	start.keysDown.clear();
+	for (int key = 0; key <= GLFW_KEY_LAST; key++) {
+		if (keysDown[key]) start.keysDown.push_back(key);
 	}
+}
+
+void OpenGL::RestoreInputState(const RecordingStart& start) {
+
+	// field by field rather than through lookAt, which would rebuild the angles with rounding of its own
+	MainCamera.setPosition(start.cameraPosition.x, start.cameraPosition.y, start.cameraPosition.z);
+	MainCamera.mCameraPointsAt = start.cameraPointsAt;
+	MainCamera.alignAxes();
+	MainCamera.mRotationX = start.rotationX;
+	MainCamera.mRotationY = start.rotationY;
+	MainCamera.mPanSpeed = start.panSpeed;
+	MainCamera.mRotateSpeed = start.rotateSpeed;
+	MainCamera.setFieldOfView(start.fieldOfView);
+	cursorSeen = start.cursorSeen;
+	cursorX = start.cursorX;
+	cursorY = start.cursorY;
+	orthographic = start.orthographic;
+	std::fill(std::begin(keysDown), std::end(keysDown), false);
+	for (int key : start.keysDown) {
+		if (key >= 0 && key <= GLFW_KEY_LAST) keysDown[key] = true;
+	}
+}
 
-	// get the delta mouse movement from last call in each dimension and update in controller
-	xMouseMovement = xpos - mouseLastX;
-	yMouseMovement = mouseLastY - ypos;
-	mouseLastX = xpos;
-	mouseLastY = ypos;
+bool OpenGL::SceneChanged() {
+
+	if (sceneDirty || MainCamera.mDirty) return true;
+	for (auto& light : mLightingArray) {
+		if (light.isDirty()) return true;
+	}
+	return false;
+}
 
-	//flag movement for the controller
-	mouseMovement = true;
+void OpenGL::TakeInputTime() {
+	if (pendingInputTime == 0.0) return;
+	if (frameInputTime == 0.0) frameInputTime = pendingInputTime;
+	pendingInputTime = 0.0;
+}
+
+void OpenGL::ClearChanges() {
+	sceneDirty = false;
+	MainCamera.mDirty = false;
+	for (auto& light : mLightingArray) light.clearDirty();
+}
+
+
+/* GLFW :: Callbacks -----------------------------------------------------------------------------------*/
+
+void OpenGL::Callbacks::Push(GLFWwindow* window, InputEvent event) {
+	OpenGL* controller = (OpenGL*)glfwGetWindowUserPointer(window);
+	if (controller == nullptr) return;
+	event.time = glfwGetTime();
+	controller->inputQueue.Push(event); // full means the controller stopped draining, the event is dropped
+}
+
+// mouse tracking, positions go on the queue and the controller works out the movement
+void OpenGL::Callbacks::_mousePosition(GLFWwindow* window, double xpos, double ypos) {
+	Push(window, { InputEventType::CURSOR, 0.0, (float)xpos, (float)ypos, 0, 0, 0 });
 }
 
 // mouse scrolling
-bool OpenGL::Callbacks::mouseScrolling = false;
-float OpenGL::Callbacks::scale;
 void OpenGL::Callbacks::_mouseScroll(GLFWwindow* window, double xoffset, double yoffset) {
-	scale = yoffset;
-	mouseScrolling = true;
+	Push(window, { InputEventType::SCROLL, 0.0, (float)xoffset, (float)yoffset, 0, 0, 0 });
 }
 
-// key callback looks for key P downpress
-bool OpenGL::Callbacks::keyP_Toggle = false;
+// every key press, repeat and release, so the controller can track what is held
 void OpenGL::Callbacks::_keyPress(GLFWwindow* window, int key, int scancode, int action, int mods) {
-	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
-		keyP_Toggle = !keyP_Toggle;
-	}
+	Push(window, { InputEventType::KEY, 0.0, 0.0f, 0.0f, key, action, mods });
 }
 
+// GLFW: whenever the window size changed (by OS or user resize) this callback function executes
+void OpenGL::Callbacks::_resizeWindow(GLFWwindow* window, int width, int height) {
+	Push(window, { InputEventType::RESIZE, 0.0, (float)width, (float)height, 0, 0, 0 });
+}
 
+// GLFW: the window contents were lost (uncovered, restored) and have to be drawn again
+void OpenGL::Callbacks::_refreshWindow(GLFWwindow* window) {
+	Push(window, { InputEventType::REFRESH, 0.0, 0.0f, 0.0f, 0, 0, 0 });
+}
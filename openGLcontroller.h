@@ -11,8 +11,30 @@
 #include "openGLmesh.h"
 #include "camera.h"
 #include "light.h"
+#include "uniforms.h"
+#include "geometryCache.h"
+#include "textureCache.h"
+#include "renderQueue.h"
+#include "glState.h"
+#include "meshArena.h"
+#include "cameraPath.h"
+#include "frameStats.h"
+#include "profiler.h"
+#include "hud.h"
+#include "framePacer.h"
+#include "inputQueue.h"
+#include "inputRecording.h"
 
+#include <string>
 #include <vector>
+#include <unordered_map>
+#include <functional>
+
+// how RunScene paces frames: every iteration, or only when something visible changed (sleeping on input otherwise)
+enum class RenderMode {
+	CONTINUOUS,
+	ON_DEMAND,
+};
 
 /*
 * Wrapper class to control the GLEW and GLFW libraries. Some of its own state information is saved in its own fields for reference.
@@ -29,51 +51,254 @@
 
 class OpenGL {
 
+	// one level of detail of a shape: its geometry and how to draw it
+	struct LodLevel {
+		GLuint vao;
+		GeometryBuffers* geometry; // null in the arena
+		ArenaRange arena;
+		GLuint nIndices;
+		GLenum indexType;
+		bool packed;
+		glm::mat4 decode;
+	};
+
 	// data about the registered mesh objects
 	struct meshID {
-		GLuint vao;
-		GLuint vbos[2];
+		GLuint vao; // shared with every mesh of the same geometry
+		GeometryBuffers* geometry;
 		GLuint nIndices;
+		GLenum indexType;
+		bool packed; // PackedVertex geometry: drawn with model * decode and the packed shader
+		glm::mat4 decode;
 		glm::mat4 model;
-		glm::mat4 rotation;
+		glm::mat3 normalMatrix; // computed when the transform is set, not per vertex
 		float shininess;
+		GLuint texture; // cache handle
+		GLuint boundTexture; // what render binds: the placeholder until the texture is resident
+		bool inArena; // drawn by the multi-draw indirect path instead of the render queue
+		ArenaRange arena;
+
+		// the last two simulation steps, model is blended between them while the shape is moving
+		MeshTransform previous;
+		MeshTransform current;
+		bool moved; // set by the current step
+
+		void setModel(const glm::mat4& m) { model = m; normalMatrix = glm::mat3(glm::transpose(glm::inverse(m))); }
+
+		// every level, finest first. The draw fields above (vao to decode) are copied from the one in use
+		std::vector<LodLevel> lods;
+		int lod;
+		glm::vec4 bounds; // bounding sphere of the finest level in model space, xyz center, w radius
+
+		void useLod(int level) {
+			const LodLevel& use = lods[level];
+			vao = use.vao; geometry = use.geometry; arena = use.arena; nIndices = use.nIndices;
+			indexType = use.indexType; packed = use.packed; decode = use.decode;
+			lod = level;
+		}
+	};
+
+	// a batch of copies of one geometry, drawn with a single glDrawElementsInstanced
+	struct instancedMeshID {
+		GLuint vao; // own VAO: shared geometry buffers + this batch's instance buffer
+		GeometryBuffers* geometry;
+		GLuint instanceBuffer; // per instance data
+		GLuint nIndices;
+		GLenum indexType;
+		GLsizei nInstances;
 		GLuint texture;
+		GLuint boundTexture;
+	};
+
+	// uniform handles for one shader program, resolved from its reflection table once at build
+	struct ShaderUniforms {
+		Uniform<glm::mat4> model;
+		Uniform<glm::mat3> normalMatrix;
+		Uniform<float> shininess;
+		Uniform<GLint> texture;
+	};
+
+	// std140 mirrors of the FrameData and LightData blocks in shaders.h (vec3s padded to vec4)
+	static const int MAX_LIGHTS = 4;
+	static const GLuint FRAME_BLOCK_BINDING = 0;
+	static const GLuint LIGHT_BLOCK_BINDING = 1;
+	static const GLuint DRAW_BLOCK_BINDING = 2; // shader storage, per draw records of the indirect path
+
+	struct FrameBlock {
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 viewPosition;
+	};
+
+	struct LightBlock {
+		glm::vec4 position[MAX_LIGHTS]; // w = strength
+		glm::vec4 color[MAX_LIGHTS];
+		GLint count;
+		GLint _pad[3];
+	};
+
+	// std430 mirror of DrawRecord in the indirect vertex shader
+	struct DrawRecord {
+		glm::mat4 model;
+		glm::mat4 normalMatrix; // only the upper 3x3 is read
+		glm::vec4 material; // x = shininess
 	};
 
-	struct FrameTime {
-		float lastFrame;
-		float _startTime; // "private"
-		void tick() { _startTime = glfwGetTime(); }
-		void tock() { lastFrame = glfwGetTime() - _startTime;}
+	// layout fixed by GL for glMultiDrawElementsIndirect
+	struct IndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance; // also the DrawRecord index, through the draw index attribute
+	};
+
+	// consecutive commands sharing a layout VAO and a texture, one glMultiDrawElementsIndirect each
+	struct IndirectGroup {
+		GLuint vao;
+		GLenum indexType;
+		GLuint texture;
+		GLsizei firstCommand;
+		GLsizei commandCount;
 	};
 
 	public:
 
 		Camera MainCamera;
 
-		void Initialize(); //call in constructor?
+		void Initialize(bool headless = false); //call in constructor?  headless = no window, renders offscreen
 		
-		void AddShape(OpenGLMesh& mesh);
+		// textured meshes added after this go into one shared buffer and are drawn a few multi-draws at a time
+		// (call before adding shapes)
+		void UseMultiDrawIndirect();
+
+		// textured shapes added after this are uploaded as 16 byte PackedVertex (vertexPacking.h) instead of floats
+		// and drawn with the packed vertex shader. Not for the instanced and multi-draw paths, which keep floats
+		void UsePackedVertices(bool enabled);
+
+		// shapes added after this draw the level of their lods chain that fits their size on screen. Meshes without
+		// a chain get one simplified from them when they are big enough (on by default)
+		void UseLods(bool enabled) { useLods = enabled; }
+
+		// new geometry is welded and reordered for the vertex cache before it is uploaded (on by default, see meshOptimizer.h)
+		void OptimizeMeshes(bool enabled) { optimizeMeshes = enabled; }
+		// how close attributes have to be to weld, when meshes are optimized (0 = exact, the default)
+		void SetWeldEpsilon(float epsilon) { weldEpsilon = epsilon; }
+
+		int AddShape(OpenGLMesh& mesh); // returns a handle for SetShapeTransform, valid until ClearScene
+
+		// takes the mesh's current transform. From the update callback it is the shape's state at the end of the
+		// step and rendering blends into it, anywhere else the shape is simply placed there
+		void SetShapeTransform(int shape, OpenGLMesh& mesh);
+		void AddInstancedShape(OpenGLMesh& mesh, const std::vector<MeshInstance>& instances); // geometry uploaded once for all instances
+		void ClearScene(); // drop all shapes, releasing shared geometry and textures
 		void AddLight(Light light);
+		Light* GetLight(int index); // edits are picked up on the next frame
 		bool RunScene();
+
+		// continuous by default. On demand, RunScene waits on input and only renders when the camera, a light, a
+		// shape or the window changed (headless runs always render continuously)
+		void SetRenderMode(RenderMode mode) { renderMode = mode; }
+
+		// called with the step length (seconds) once per fixed simulation step of RunScene, however fast frames are
+		// rendered. On demand, steps only run while something is moving, so animations that start on their own
+		// need continuous rendering
+		void SetUpdateCallback(std::function<void(OpenGL&, float)> update) { updateCallback = update; }
+
+		// RunScene polls the mouse once more after the draws are sorted and writes the view straight into a mapped
+		// uniform buffer just before they are issued
+		void UseLateLatch(bool enabled);
+
+		// how swaps wait for the display (vsync by default, adaptive falls back to vsync where unsupported) and an
+		// optional frame rate cap held by the pacer, 0 = none
+		void SetSwapMode(SwapMode mode);
+		void SetFrameCap(double fps) { framePacer.SetTargetFps(fps); }
+		const FramePacer& GetFramePacer() { return framePacer; }
+
+		// makes RunScene return after this many frames or seconds (0 = no limit), for benchmarks and headless runs
+		void StopAfter(int frames, double seconds);
+
+		// renders this many frames without vsync or input handling, returns the mean ms per frame
+		double RunFrames(int frames);
+
+		// times the current scene with the normal matrix from the CPU and again with it rebuilt per vertex, in the
+		// single, instanced and multi-draw indirect textured shaders (packed shapes keep the CPU one)
+		void BenchmarkVertexShader(int frames);
+
+		// flies the camera along the path at a fixed simulated timestep and records every frame's CPU, GPU
+		// and total time (vsync off, after all textures are resident)
+		FrameTimings RunCameraPath(const CameraPath& path, const std::string& scene, float timestep, int frames);
+
+		// RunScene keeps every frame's input in this recording (nullptr stops), for the caller to save afterwards
+		void RecordInput(InputRecording* recording) { this->recording = recording; }
+
+		// feeds a recording back frame by frame from the state it started in, uncapped and ignoring live input,
+		// and times every frame like RunCameraPath. Escape presses in it do not close the window
+		FrameTimings RunReplay(const InputRecording& session, const std::string& scene);
+
+		// counters from the last rendered frame
+		const RenderStats& GetRenderStats() { return renderStats; }
+
+		// CPU zones and GPU pass timings, off until enabled
+		Profiler& GetProfiler() { return profiler; }
+
+		// performance overlay (also toggled with H)
+		void ShowHud(bool visible);
 		
 
 	private:
 
 		void SetVersionInfo();
+		void ApplySwapMode();
 		void CreateWindow();
+		void CreateHeadlessContext();
+		void CreateOffscreenTarget();
 		void AssignCallbackRoutines();
 
 		GLuint BuildShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
 		void checkShaderCompilation(GLuint& shaderID);
 		void checkShaderLink(GLuint& shaderID);
+		ShaderUniforms ResolveUniforms(GLuint shaderProgramID);
 
 		GLuint AddTexture(const char* fileName);
-		void SetupLights();
+		void ResolveTextures();
+		void UpdateSharedUniforms();
 
-		void Render();
-		void ProcessKeyboardInput();
-		void ProcessMouseInput();
+		void Render(); // DrawFrame + swap
+		void DrawFrame();
+		void DrawHud();
+		void WaitForTextures();
+		void BuildRenderQueue();
+		void SubmitRenderQueue();
+		void BuildIndirectDraws();
+		void SubmitIndirectDraws(RenderStats& stats);
+
+		// the mesh to upload: meshInfo itself, or an optimized copy in optimized when its geometry is new
+		OpenGLMesh& PrepareGeometry(OpenGLMesh& meshInfo, bool inArena, bool packed, OpenGLMesh& optimized);
+		LodLevel AcquireLevel(OpenGLMesh& meshInfo, bool inArena, bool packed);
+		std::vector<OpenGLMesh>& LodChain(OpenGLMesh& meshInfo); // its own, a simplified one, or none
+		bool SelectLod(meshID& mesh, float screenHeight); // true when the level changed
+		void ProcessInput(bool apply = true); // drains the input queue. Not applied, only key and cursor state follow it
+		void DrainInput(); // into drainedEvents
+		void ApplyInput(const std::vector<InputEvent>& events, bool apply);
+		void DiscardInput();
+		void CaptureInputState(RecordingStart& start);
+		void RestoreInputState(const RecordingStart& start);
+
+		// DrawFrame + swap for each frame with advance(frame) first, timing CPU, GPU and the whole frame
+		FrameTimings TimeFrames(const char* label, const std::string& scene, float timestep, int frames, bool liveInput,
+			const std::function<void(int)>& advance);
+		bool SceneChanged(); // anything visible differs from the last rendered frame
+		void ClearChanges();
+		void LatchView();
+		void UpdateSimulation(double elapsed);
+		void StepSimulation(float step);
+		void InterpolateShapes(float alpha);
+		bool SimulationActive(); // moving, or about to: steps have to keep running
+		void TakeInputTime(); // the oldest input not yet on screen belongs to the frame being drawn
+
+		const float NEAR_PLANE = 0.1f;
+		const float FAR_PLANE = 100.0f;
 
 #define ORTHO 1
 #define	PERSPECTIVE 0
@@ -82,12 +307,129 @@ class OpenGL {
 		// the active window used as a target reference for inputs and rendering
 		GLFWwindow* window;
 
+		// headless: hidden window with an OSMesa/EGL context, frames go to this framebuffer
+		bool headless = false;
+		GLuint offscreenFramebuffer = 0;
+		GLuint offscreenColor = 0;
+		GLuint offscreenDepth = 0;
+
+		// whole frame timing for RunScene, its smoothed delta feeds the simulation
+		FramePacer framePacer;
+
+		// fixed timestep simulation: held keys and the update callback advance in steps of SIMULATION_STEP, rendering
+		// blends the last two steps by simulationAlpha (how far into the next step the frame is)
+		const float SIMULATION_STEP = 1.0f / 120.0f;
+		const int MAX_STEPS_PER_FRAME = 8; // further behind than this the backlog is dropped, rather than spiralling
+		double simulationAccumulator = 0.0;
+		float simulationAlpha = 1.0f;
+		bool simulating = false; // inside a step
+		long long simulationSteps = 0;
+		std::vector<CameraDirection> heldDirections; // sampled per frame, applied per step
+		std::vector<int> movedShapes; // blending this frame
+		std::vector<int> settledShapes; // stopped since the last frame, written once at their final transform
+		std::function<void(OpenGL&, float)> updateCallback;
+		SwapMode swapMode = SwapMode::VSYNC;
+
+		// RunScene limits, 0 = run until the window closes
+		int maxFrames = 0;
+		double maxSeconds = 0.0;
+
+		// on demand rendering: sceneDirty covers shapes, textures, projection and the HUD, the camera and lights
+		// carry their own flags. Waits time out so the limits above and streaming textures are still checked
+		RenderMode renderMode = RenderMode::CONTINUOUS;
+		bool sceneDirty = true;
+
+		// a resize is applied when the next frame starts, not when its event is drained: the late latch drains
+		// input halfway through a frame, after some passes already drew at the old size
+		bool viewportPending = false;
+		int viewportWidth = 0;
+		int viewportHeight = 0;
+		const double IDLE_WAIT_SECONDS = 0.25;
+		const double LOADING_WAIT_SECONDS = 0.01;
+
+		// late latch: the FrameData block comes from the ring instead of frameUniformBuffer. Input is only sampled
+		// again inside RunScene, scripted runs keep the camera they set
+		bool lateLatch = false;
+		bool latchInput = false;
+		UniformRing frameRing;
+
+		// input to swap latency: time of the oldest input drawn by this frame, and every measurement of this RunScene
+		double frameInputTime = 0.0;
+		std::vector<double> inputLatencies;
+		const size_t MAX_LATENCY_SAMPLES = 100000; // plenty for the exit summary, a kiosk runs for days
+
 		// active linked shader program ID stored
 		GLuint colorShader;
 		GLuint textureShader;
+		GLuint instancedTextureShader;
+		GLuint packedTextureShader = 0; // built by UsePackedVertices
+
+		// reflected uniforms per program, filled in BuildShaderProgram
+		std::unordered_map<GLuint, UniformTable> mUniformTables;
+		ShaderUniforms colorUniforms;
+		ShaderUniforms textureUniforms;
+		ShaderUniforms instancedUniforms;
+		ShaderUniforms packedUniforms;
+
+		// uniform blocks shared by all programs, re-uploaded only when their contents change
+		UniformBuffer frameUniformBuffer;
+		UniformBuffer lightUniformBuffer;
 
 		// holds mesh VAOs as created
 		std::vector<meshID> meshIds;
+		std::vector<instancedMeshID> instancedMeshIds;
+
+		// unique geometry on the GPU, shared between meshes
+		GeometryCache geometryCache;
+
+		// textures by path and by file contents, shared between meshes
+		TextureCache textureCache;
+
+		// draws for the current frame, sorted by state. Batches are tagged so they share the queue with meshes
+		static const uint32_t INSTANCED_DRAW = 0x80000000u;
+		RenderQueue renderQueue;
+		RenderStats renderStats;
+
+		// multi-draw indirect path: the arena holds the geometry, the commands and records are rebuilt only when
+		// the set of meshes or their textures change, so a frame costs one draw per group
+		bool multiDrawIndirect = false;
+		bool indirectDirty = true;
+		bool optimizeMeshes = true;
+		bool packedVertices = false;
+
+		// levels of detail: a level is good enough while it has a triangle for every LOD_PIXELS_PER_TRIANGLE square
+		// pixels of the shape's bounding sphere. A coarser level only takes over once it would still have
+		// LOD_HYSTERESIS more than that, so shapes near a switch do not flicker between two levels
+		bool useLods = true;
+		const float LOD_PIXELS_PER_TRIANGLE = 24.0f;
+		const float LOD_HYSTERESIS = 0.5f;
+		const size_t SIMPLIFY_MIN_TRIANGLES = 4096;
+		std::unordered_map<std::string, std::vector<OpenGLMesh>> simplifiedLods; // by geometry key, for meshes without a chain
+		long long lodSwitches = 0;
+		float weldEpsilon = 0.0f;
+		MeshArena meshArena;
+		GLuint indirectShader = 0;
+		ShaderUniforms indirectUniforms;
+		GLuint drawRecordBuffer = 0;
+		GLuint indirectBuffer = 0;
+		GLsizeiptr drawRecordCapacity = 0;
+		GLsizeiptr indirectCapacity = 0;
+		std::vector<DrawRecord> drawRecords;
+		std::vector<IndirectCommand> indirectCommands;
+		std::vector<IndirectGroup> indirectGroups;
+		long long indirectTriangles = 0;
+
+		Profiler profiler;
+
+		// overlay drawn after the scene pass, it reads renderStats and the caches' memory counters
+		Hud hud;
+		GLuint hudShader;
+		bool hudVisible = false;
+		GpuFrameTimer gpuFrameTimer;
+		double lastRenderStart = 0.0;
+
+		// every bind, program switch and enable in the render loop goes through here
+		GLStateCache glState;
 
 		// hold lights attached on scene
 		std::vector<Light> mLightingArray;
@@ -95,15 +437,25 @@ class OpenGL {
 		// these are updated per scene
 		glm::mat4 view;
 		glm::mat4 projection;
-		FrameTime frameTime;
+
+
+		// input, pushed by the GLFW callbacks and drained once per frame (and again by the late latch)
+		InputQueue inputQueue;
+		bool keysDown[GLFW_KEY_LAST + 1] = {};
+		bool cursorSeen = false; // the first cursor event only sets the position, there is nothing to move from
+		float cursorX = 0.0f;
+		float cursorY = 0.0f;
+		bool orthographic = false; // P
+		double pendingInputTime = 0.0; // oldest drained input not yet taken by a frame, 0 = none
+		std::vector<InputEvent> drainedEvents;
+		InputRecording* recording = nullptr;
 
 
 		/* Callbacks for GLFW controls 
 				glfw api needs pointer to a function, not an object, so these callbacks must be
 				essentially outside of the object. Very anti-OOP
-				I created its own static class that in turn updates a few private variables in
-				OpenGL Control and flags for processing.
-				This way at least access to them remains through controller only.
+				They only stamp each event and push it onto the queue of the controller that owns the window
+				(the window user pointer), the controller reads them from there.
 		*/
 
 		class Callbacks {
@@ -112,27 +464,15 @@ class OpenGL {
 
 		private: 
 
-			// mouse position
-			// the static variables hold information from a single callback so that an object instance can reference them
-			static bool firstMouseMovement;
-			static bool mouseMovement;
-			static float mouseLastX;
-			static float mouseLastY;
-			static float xMouseMovement;
-			static float yMouseMovement;
-			static void _mousePosition(GLFWwindow* window, double xpos, double ypos);
+			static void Push(GLFWwindow* window, InputEvent event);
 
-			// mouse scroll
-			static bool mouseScrolling;
-			static float scale;
+			static void _mousePosition(GLFWwindow* window, double xpos, double ypos);
 			static void _mouseScroll(GLFWwindow* window, double xoffset, double yoffset);
+			static void _keyPress(GLFWwindow* window, int key, int scancode, int action, int mods);
 
-			// window resize
+			// window resize, and the window needing its contents drawn again (uncovered, restored)
 			static void _resizeWindow(GLFWwindow* window, int width, int height);
-
-			// key press
-			static bool keyP_Toggle;
-			static void _keyPress(GLFWwindow* window, int key, int scancode, int action, int mods);
+			static void _refreshWindow(GLFWwindow* window);
 		};
 
 };
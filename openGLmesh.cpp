@@ -1,5 +1,8 @@
 #include "openGLmesh.h"
 
+#include <algorithm>
+#include <cstring>
+
 OpenGLMesh::OpenGLMesh() {
 
 	/*
@@ -11,6 +14,7 @@ OpenGLMesh::OpenGLMesh() {
 	rotation = glm::mat4(1.0f);
 	translation = glm::mat4(1.0f);
 	texture = "";
+	geometryKey = "";
 	floatsPerVertex = 3;
 	floatsPerColor = 4;
 	floatsPerUV = 0;
@@ -37,6 +41,22 @@ void OpenGLMesh::setTranslation(float x, float y, float z) {
 	translation = glm::translate(glm::vec3(x, y, z));
 }
 
+void OpenGLMesh::addTranslation(float x, float y, float z) {
+	translation = glm::translate(glm::vec3(x, y, z)) * translation;
+}
+
+MeshTransform OpenGLMesh::transform() {
+	return { glm::vec3(translation[3]), glm::quat_cast(rotation), glm::vec3(scale[0][0], scale[1][1], scale[2][2]) };
+}
+
+glm::mat4 MeshTransform::model() const {
+	return glm::translate(translation) * glm::mat4_cast(rotation) * glm::scale(scale);
+}
+
+MeshTransform MeshTransform::Mix(const MeshTransform& from, const MeshTransform& to, float t) {
+	return { glm::mix(from.translation, to.translation, t), glm::slerp(from.rotation, to.rotation, t), glm::mix(from.scale, to.scale, t) };
+}
+
 void OpenGLMesh::setShininess(float factor) {
 	if (factor > 1.0f) shininess = 1.0f;
 	else if (factor < 0.0f) shininess = 0.0f;
@@ -66,10 +86,78 @@ void OpenGLMesh::printVertices() {
 
 void OpenGLMesh::printIndices() {
 
-	int i = 1;
-	for (auto point : indices) {
-		std::cout << point << " ";
-		if (i % 3 == 0) std::cout << std::endl;
-		i++;
+	for (size_t i = 0; i < indices.size(); i++) {
+		std::cout << indices[i] << " ";
+		if ((i + 1) % 3 == 0) std::cout << std::endl;
 	}
+}
+
+MeshIndices::MeshIndices(std::initializer_list<GLuint> list) {
+	*this = list;
+}
+
+MeshIndices& MeshIndices::operator=(std::initializer_list<GLuint> list) {
+	clear();
+	GLuint maxIndex = 0;
+	for (GLuint index : list) maxIndex = std::max(maxIndex, index);
+	widen(WidthFor(maxIndex));
+	reserve(list.size());
+	for (GLuint index : list) push_back(index);
+	return *this;
+}
+
+GLuint MeshIndices::WidthFor(GLuint maxIndex) {
+	if (maxIndex <= 0xFF) return 1;
+	if (maxIndex <= 0xFFFF) return 2;
+	return 4;
+}
+
+void MeshIndices::push_back(GLuint index) {
+
+	GLuint needed = WidthFor(index);
+	if (needed > width) widen(needed);
+
+	// stored through the narrow type, so the bytes are right whatever the byte order
+	size_t at = bytes.size();
+	bytes.resize(at + width);
+	if (width == 1) bytes[at] = (uint8_t)index;
+	else if (width == 2) { uint16_t narrow = (uint16_t)index; memcpy(&bytes[at], &narrow, 2); }
+	else memcpy(&bytes[at], &index, 4);
+	count++;
+}
+
+GLuint MeshIndices::operator[](size_t i) const {
+	if (width == 1) return bytes[i];
+	if (width == 2) { uint16_t narrow; memcpy(&narrow, &bytes[i * 2], 2); return narrow; }
+	GLuint index;
+	memcpy(&index, &bytes[i * 4], 4);
+	return index;
+}
+
+void MeshIndices::clear() {
+	bytes.clear();
+	width = 1;
+	count = 0;
+}
+
+void MeshIndices::widenFor(size_t vertexCount) {
+	if (vertexCount == 0) return;
+	widen(WidthFor((GLuint)std::min<size_t>(vertexCount - 1, 0xFFFFFFFF)));
+}
+
+GLenum MeshIndices::getType() const {
+	if (width == 1) return GL_UNSIGNED_BYTE;
+	if (width == 2) return GL_UNSIGNED_SHORT;
+	return GL_UNSIGNED_INT;
+}
+
+void MeshIndices::widen(GLuint newWidth) {
+
+	if (newWidth <= width) return;
+
+	MeshIndices wider;
+	wider.width = newWidth;
+	wider.bytes.reserve(std::max(bytes.capacity() / width, count) * newWidth);
+	for (size_t i = 0; i < count; i++) wider.push_back((*this)[i]);
+	*this = std::move(wider);
 }
\ No newline at end of file
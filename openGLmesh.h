@@ -3,38 +3,115 @@
 
 #include <GL\glew.h>
 #include <vector>
+#include <cstdint>
+#include <initializer_list>
 
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <string>
 #include <iostream>
 
+// per-instance data for the instanced render path, in the same layout as the instance buffer
+struct MeshInstance {
+	glm::mat4 model;
+	glm::mat3 normalMatrix; // inverse transpose of the model, computed here instead of per vertex
+	float shininess;
+};
+
+// a mesh transform kept as its parts, so two of them can be blended (translation and scale linearly, rotation by slerp)
+struct MeshTransform {
+	glm::vec3 translation;
+	glm::quat rotation;
+	glm::vec3 scale;
+
+	glm::mat4 model() const;
+	static MeshTransform Mix(const MeshTransform& from, const MeshTransform& to, float t);
+};
+
+/*
+* Triangle indices kept at the narrowest width that addresses every vertex: 8 bits up to 256 vertices, 16 up to
+* 65536, 32 beyond. Adding an index too big for the current width re-encodes what is there at the wider one, so a
+* mesh can be filled without knowing its size (widenFor skips the re-encoding when the vertex count is known).
+* data() and byteSize() are ready to upload as they are, getType() is what the draw call takes.
+*/
+class MeshIndices {
+
+	public:
+
+		MeshIndices() {}
+		MeshIndices(std::initializer_list<GLuint> list);
+		MeshIndices& operator=(std::initializer_list<GLuint> list);
+
+		void push_back(GLuint index);
+		GLuint operator[](size_t i) const;
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		void clear(); // back to 8 bits too
+		void reserve(size_t n) { bytes.reserve(n * width); }
+
+		// makes room for indices up to vertexCount - 1
+		void widenFor(size_t vertexCount);
+
+		GLuint getWidth() const { return width; } // bytes per index
+		GLenum getType() const; // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		const void* data() const { return bytes.data(); }
+		GLsizeiptr byteSize() const { return (GLsizeiptr)bytes.size(); }
+
+		bool operator==(const MeshIndices& other) const { return width == other.width && bytes == other.bytes; }
+		bool operator!=(const MeshIndices& other) const { return !(*this == other); }
+
+		static GLuint WidthFor(GLuint maxIndex);
+
+	private:
+
+		void widen(GLuint newWidth);
+
+		std::vector<uint8_t> bytes;
+		GLuint width = 1;
+		size_t count = 0;
+};
+
 class OpenGLMesh {
 
 	public:
 
 
 		std::vector<GLfloat> vertices;
-		std::vector<GLushort> indices;
+		MeshIndices indices;
 
 		GLuint floatsPerVertex;
 		GLuint floatsPerColor;
 		GLuint floatsPerUV;
 		GLuint floatsPerNormal;
 		std::string texture;
+
+		// identifies generated geometry (shape + tessellation) for the geometry cache, empty = hash the contents
+		std::string geometryKey;
+
+		// coarser versions of this mesh, finest first, for drawing it when it is small on screen (empty = none)
+		std::vector<OpenGLMesh> lods;
 		
 
-		GLuint nIndices() { return indices.size(); }
+		GLuint nIndices() { return (GLuint)indices.size(); }
 
 		glm::mat4 model() { return translation * rotation * scale; }
+		glm::mat3 normalMatrix() { return glm::mat3(glm::transpose(glm::inverse(model()))); }
+
+		// snapshot of the current transform and material, for the instanced path
+		MeshInstance instance() { return { model(), normalMatrix(), shininess }; }
+
+		// the current transform in parts, for interpolation
+		MeshTransform transform();
 
 		void setScale(float x, float y, float z);
 		void setRotation(float rotation, float x, float y, float z);
 		void addRotation(float rotation, float x, float y, float z);
 		glm::mat4 getRotation() { return rotation; }
 		void setTranslation(float x, float y, float z);
+		void addTranslation(float x, float y, float z); // moves from the current translation
 
 		void setShininess(float factor);
 		float getShininess();
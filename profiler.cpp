@@ -0,0 +1,131 @@
+#include "profiler.h"
+
+void Profiler::SetEnabled(bool enabled) {
+
+	// start clean either way, zones left open across the switch would never be closed
+	this->enabled = enabled;
+	inFrame = false;
+	openZones.clear();
+	current = FrameRecord();
+	current.frameIndex = frameIndex;
+}
+
+void Profiler::StartFrame() {
+
+	// this set was last used two frames ago, its results should be in by now
+	QuerySet& set = querySets[frameIndex % QUERY_SETS];
+	ResolveQueries(set);
+	set.used = 0;
+	set.frameIndex = frameIndex;
+
+	current = FrameRecord();
+	current.frameIndex = frameIndex;
+	openZones.clear();
+	inFrame = true;
+	PushZone("Frame");
+}
+
+void Profiler::FinishFrame() {
+
+	while (!openZones.empty()) PopZone(); // closes "Frame" (and anything left open by mistake)
+	inFrame = false;
+
+	history.push_back(std::move(current));
+	if (history.size() > HISTORY_FRAMES) history.pop_front();
+	frameIndex++;
+}
+
+void Profiler::PushZone(const char* name) {
+	openZones.push_back((int)current.cpuZones.size());
+	current.cpuZones.push_back({ name, (int)openZones.size() - 1, NowUs(), 0.0 });
+}
+
+void Profiler::PopZone() {
+	if (openZones.empty()) return;
+	CpuZone& zone = current.cpuZones[openZones.back()];
+	zone.durationUs = NowUs() - zone.startUs;
+	openZones.pop_back();
+}
+
+void Profiler::StartGpuZone(const char* name) {
+
+	QuerySet& set = querySets[frameIndex % QUERY_SETS];
+	if (set.used == (int)set.queries.size()) {
+		GLuint query;
+		glCreateQueries(GL_TIME_ELAPSED, 1, &query);
+		set.queries.push_back(query);
+	}
+
+	current.gpuZones.push_back({ name, NowUs(), -1.0 });
+	glBeginQuery(GL_TIME_ELAPSED, set.queries[set.used++]);
+	gpuZoneOpen = true;
+}
+
+void Profiler::ResolveQueries(QuerySet& set) {
+
+	if (set.used == 0) return;
+
+	// the frame may already have dropped out of the history, or profiling was switched off and on
+	FrameRecord* frame = nullptr;
+	for (auto it = history.rbegin(); it != history.rend(); ++it) {
+		if (it->frameIndex == set.frameIndex) { frame = &*it; break; }
+	}
+	if (frame == nullptr || (int)frame->gpuZones.size() != set.used) return;
+
+	for (int i = 0; i < set.used; i++) {
+		GLint available = 0;
+		glGetQueryObjectiv(set.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) continue; // dropped, waiting would stall the CPU on the GPU
+
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v(set.queries[i], GL_QUERY_RESULT, &elapsedNs);
+		frame->gpuZones[i].durationUs = elapsedNs / 1000.0;
+	}
+}
+
+void GpuFrameTimer::Begin() {
+
+	if (!created) {
+		glCreateQueries(GL_TIMESTAMP, LATENCY * 2, &queries[0][0]);
+		created = true;
+	}
+
+	// this pair was written LATENCY frames ago, take its result if it is in before reusing it
+	GLuint* pair = queries[frame % LATENCY];
+	if (frame >= LATENCY) {
+		GLint available = 0;
+		glGetQueryObjectiv(pair[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(pair[0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(pair[1], GL_QUERY_RESULT, &end);
+			lastMs = (end - start) / 1.0e6;
+		}
+	}
+	glQueryCounter(pair[0], GL_TIMESTAMP);
+}
+
+void GpuFrameTimer::End() {
+	glQueryCounter(queries[frame % LATENCY][1], GL_TIMESTAMP);
+	frame++;
+}
+
+void Profiler::WriteChromeTrace(std::ostream& out) {
+
+	out << "{\"traceEvents\": [\n";
+	out << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU\"}},\n";
+	out << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"GPU\"}}";
+
+	for (auto& frame : history) {
+		for (auto& zone : frame.cpuZones) {
+			out << ",\n  {\"name\": \"" << zone.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": " << zone.startUs
+				<< ", \"dur\": " << zone.durationUs << ", \"args\": {\"frame\": " << frame.frameIndex << "}}";
+		}
+		for (auto& zone : frame.gpuZones) {
+			if (zone.durationUs < 0.0) continue;
+			out << ",\n  {\"name\": \"" << zone.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 2, \"ts\": " << zone.issuedUs
+				<< ", \"dur\": " << zone.durationUs << ", \"args\": {\"frame\": " << frame.frameIndex << "}}";
+		}
+	}
+	out << "\n]}\n";
+}
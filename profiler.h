@@ -0,0 +1,133 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL\glew.h>
+
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <ostream>
+
+/*
+* Frame profiler. CPU zones are named, nest, and are timed with steady_clock. GPU zones wrap a render pass
+* in a GL_TIME_ELAPSED query; GL does not allow those to nest, so GPU zones must not overlap each other.
+*
+* GPU results are read two frames later (the query sets are double buffered), when they are normally done.
+* A result that is still not available is dropped instead of waiting on it, so profiling never stalls the
+* pipeline. The last HISTORY_FRAMES frames are kept and can be written as a Chrome trace (chrome://tracing
+* or ui.perfetto.dev). GPU zones go on their own track, placed at the CPU time their pass was issued.
+*
+* Names must be string literals (or otherwise outlive the profiler), only the pointer is stored.
+* Disabled, every call is an inline flag test and nothing else. Zones outside BeginFrame/EndFrame are ignored,
+* so passes rendered by loops that do not count frames never queue queries nobody resolves.
+*/
+class Profiler {
+
+	public:
+
+		static const int HISTORY_FRAMES = 300;
+
+		void SetEnabled(bool enabled);
+		bool isEnabled() const { return enabled; }
+
+		void BeginFrame() { if (enabled) StartFrame(); }
+		void EndFrame() { if (enabled) FinishFrame(); }
+
+		void BeginZone(const char* name) { if (enabled && inFrame) PushZone(name); }
+		void EndZone() { if (enabled && inFrame) PopZone(); }
+
+		void BeginGpuZone(const char* name) { if (enabled && inFrame) StartGpuZone(name); }
+		void EndGpuZone() { if (gpuZoneOpen) { glEndQuery(GL_TIME_ELAPSED); gpuZoneOpen = false; } }
+
+		// whole history as {"traceEvents": [...]}
+		void WriteChromeTrace(std::ostream& out);
+
+	private:
+
+		struct CpuZone {
+			const char* name;
+			int depth;
+			double startUs;
+			double durationUs;
+		};
+
+		struct GpuZone {
+			const char* name;
+			double issuedUs; // CPU time of BeginGpuZone, used to place it in the trace
+			double durationUs; // -1 until the query result is in (or if it was dropped)
+		};
+
+		struct FrameRecord {
+			long long frameIndex;
+			std::vector<CpuZone> cpuZones;
+			std::vector<GpuZone> gpuZones;
+		};
+
+		// queries issued in one frame, reused every second frame
+		struct QuerySet {
+			std::vector<GLuint> queries;
+			int used = 0;
+			long long frameIndex = -1; // the frame whose zones these belong to
+		};
+
+		void StartFrame();
+		void FinishFrame();
+		void PushZone(const char* name);
+		void PopZone();
+		void StartGpuZone(const char* name);
+		void ResolveQueries(QuerySet& set);
+
+		double NowUs() const { return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count(); }
+
+		bool enabled = false;
+		bool inFrame = false;
+		bool gpuZoneOpen = false;
+		std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+		long long frameIndex = 0;
+		FrameRecord current;
+		std::vector<int> openZones; // indices into current.cpuZones
+		std::deque<FrameRecord> history;
+
+		static const int QUERY_SETS = 2;
+		QuerySet querySets[QUERY_SETS];
+};
+
+/*
+* GPU time of one part of every frame, for on screen display. Uses GL_TIMESTAMP queries, which unlike
+* GL_TIME_ELAPSED may overlap the profiler's zones. Results are read LATENCY frames later and only if
+* they are ready, so it never waits on the GPU.
+*/
+class GpuFrameTimer {
+
+	public:
+
+		void Begin();
+		void End();
+
+		// the most recent frame that has come back
+		double getLastMs() const { return lastMs; }
+
+	private:
+
+		static const int LATENCY = 3;
+		GLuint queries[LATENCY][2] = {};
+		bool created = false;
+		long long frame = 0;
+		double lastMs = 0.0;
+};
+
+// CPU zone for the rest of the enclosing block
+class ProfileScope {
+
+	public:
+
+		ProfileScope(Profiler& profiler, const char* name) : profiler(profiler) { profiler.BeginZone(name); }
+		~ProfileScope() { profiler.EndZone(); }
+
+	private:
+
+		Profiler& profiler;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "renderQueue.h"
+
+#include <algorithm>
+
+uint64_t RenderQueue::MakeKey(uint32_t program, uint32_t texture, uint32_t vao, float depth01) {
+
+	// quantize depth to 24 bits, anything outside the clip range just sorts first or last
+	depth01 = std::clamp(depth01, 0.0f, 1.0f);
+	uint64_t depth = (uint64_t)(depth01 * 0xFFFFFF);
+
+	return ((uint64_t)(program & 0xFF) << 56)
+		| ((uint64_t)(texture & 0xFFFF) << 40)
+		| ((uint64_t)(vao & 0xFFFF) << 24)
+		| depth;
+}
+
+void RenderQueue::Sort() {
+
+	size_t count = mItems.size();
+	if (count < 2) return;
+	mScratch.resize(count);
+
+	for (int shift = 0; shift < 64; shift += 8) {
+
+		size_t histogram[256] = {};
+		for (auto& item : mItems) histogram[(item.key >> shift) & 0xFF]++;
+
+		// every key has the same byte here, this pass would not move anything
+		if (histogram[(mItems[0].key >> shift) & 0xFF] == count) continue;
+
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++) {
+			size_t bucketSize = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketSize;
+		}
+
+		// stable scatter, so earlier (less significant) passes keep their order within a bucket
+		for (auto& item : mItems) mScratch[histogram[(item.key >> shift) & 0xFF]++] = item;
+		mItems.swap(mScratch);
+	}
+}
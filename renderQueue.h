@@ -0,0 +1,60 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+* Per frame list of draws, sorted by a 64 bit key so that draws sharing a shader, then a texture, then a VAO
+* end up next to each other, and within those front to back (cheap early depth rejection). Submission
+* then only has to touch GL state where the key changes.
+*
+* Key layout, most significant first:
+*   [63..56] shader program   [55..40] texture   [39..24] VAO   [23..0] view depth
+*
+* GL object names are small integers handed out in order, so they are used directly (masked to the field).
+* The sort is an LSD radix sort on bytes, which is linear in the number of draws, and skips any byte that
+* is the same for every key (most frames only have one program, so the top byte costs nothing).
+*/
+
+struct DrawItem {
+	uint64_t key;
+	uint32_t index; // which mesh (or batch) the render loop should draw
+};
+
+// counted by the render loop each frame
+struct RenderStats {
+	int drawCalls = 0;
+	int instances = 0; // objects drawn, instanced copies included
+	long long triangles = 0;
+	int programChanges = 0;
+	int textureChanges = 0;
+	int vaoChanges = 0;
+	int glCallsIssued = 0; // state calls that reached GL
+	int glCallsSkipped = 0; // redundant state calls the state cache dropped
+	double cpuMs = 0.0; // building and submitting the frame
+	double gpuMs = 0.0; // scene pass on the GPU, a few frames old (only measured while the HUD is up)
+	double inputLatencyMs = 0.0; // input event to swap, from the most recent frame that had input
+
+	int stateChanges() const { return programChanges + textureChanges + vaoChanges; }
+};
+
+class RenderQueue {
+
+	public:
+
+		static uint64_t MakeKey(uint32_t program, uint32_t texture, uint32_t vao, float depth01);
+
+		void Clear() { mItems.clear(); }
+		void Push(uint64_t key, uint32_t index) { mItems.push_back({ key, index }); }
+		void Sort();
+
+		const std::vector<DrawItem>& Items() const { return mItems; }
+
+	private:
+
+		std::vector<DrawItem> mItems;
+		std::vector<DrawItem> mScratch; // kept between frames so sorting does not allocate
+};
+
+#endif
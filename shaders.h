@@ -24,26 +24,278 @@ GLSL(440,
 	out vec2 vertexTextureCoordinate;
 	out vec3 vertexNormal;
 	out vec3 vertexFragmentPosition;
+	flat out float materialShininess;
 
 	// uniforms do not change per pixel
 	uniform mat4 model;
-	uniform mat4 rotation; // the rotation value for the current model, set at render for each
-	uniform mat4 view;
-	uniform mat4 projection;
+	uniform mat3 normalMatrix; // inverse transpose of the model, computed once per object on the CPU
+	uniform float shininess; // per material, forwarded so the fragment shader is shared with the instanced path
+
+	// per frame camera data, shared by all programs (binding 0 = OpenGL::FRAME_BLOCK_BINDING)
+	layout(std140, binding = 0) uniform FrameData {
+		mat4 view;
+		mat4 projection;
+		vec4 viewPosition;
+	};
 
 	void main()
 	{
 		gl_Position = projection * view * model * vec4(aPos, 1.0f);
 		vertexFragmentPosition = vec3(model * vec4(aPos, 1.0f));
 
-		// rotate normals based on model rotation here, because this is much easier than doing it in the mesh on CPU time
-		vec4 normal4 = vec4(normal, 1.0f); // convert to 4d to match mat4
-		normal4 *= rotation;
-		vec3 rNormal = normal4.xyz; // cast back to vec3 to match rest of code
-
-		vertexNormal = mat3(transpose(inverse(model))) * rNormal; // normals in world space (no view)
+		vertexNormal = normalMatrix * normal; // normals in world space (no view)
 		colorFromVS = colorFromVBO; 
 		vertexTextureCoordinate = textureCoordinate;
+		materialShininess = shininess;
+	}
+);
+
+// Vertex Shader Source : PACKED
+// the vertex shader above for the PackedVertex layout (vertexPacking.h). Positions come in 0..1 across the mesh
+// bounds and the model uniform already holds the matrix back from there, so only the octahedral normal is decoded
+const char* packedVertexShaderSource =
+
+GLSL(440,
+
+	layout(location = 0) in vec3 aPos;
+	layout(location = 2) in vec2 textureCoordinate;
+	layout(location = 3) in vec2 octahedralNormal;
+
+	out vec2 vertexTextureCoordinate;
+	out vec3 vertexNormal;
+	out vec3 vertexFragmentPosition;
+	flat out float materialShininess;
+
+	uniform mat4 model; // includes the bounds
+	uniform mat3 normalMatrix; // from the model without them
+	uniform float shininess;
+
+	layout(std140, binding = 0) uniform FrameData {
+		mat4 view;
+		mat4 projection;
+		vec4 viewPosition;
+	};
+
+	// same as OctDecode in vertexPacking.cpp
+	vec3 OctDecode(vec2 e)
+	{
+		vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+		if (n.z < 0.0f) {
+			n.xy = (1.0f - abs(e.yx)) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return normalize(n);
+	}
+
+	void main()
+	{
+		vec4 worldPosition = model * vec4(aPos, 1.0f);
+		gl_Position = projection * view * worldPosition;
+		vertexFragmentPosition = worldPosition.xyz;
+
+		vertexNormal = normalMatrix * OctDecode(octahedralNormal);
+		vertexTextureCoordinate = textureCoordinate;
+		materialShininess = shininess;
+	}
+);
+
+// Vertex Shader Source : PER VERTEX NORMAL MATRIX
+// reference only, for the vertex throughput benchmark: the vertex shader above as it was before the normal
+// matrix moved to the CPU, inverting the model for every vertex
+const char* perVertexNormalShaderSource =
+
+GLSL(440,
+
+	layout(location = 0) in vec3 aPos;
+	layout(location = 2) in vec2 textureCoordinate;
+	layout(location = 3) in vec3 normal;
+
+	out vec2 vertexTextureCoordinate;
+	out vec3 vertexNormal;
+	out vec3 vertexFragmentPosition;
+	flat out float materialShininess;
+
+	uniform mat4 model;
+	uniform float shininess;
+
+	layout(std140, binding = 0) uniform FrameData {
+		mat4 view;
+		mat4 projection;
+		vec4 viewPosition;
+	};
+
+	void main()
+	{
+		gl_Position = projection * view * model * vec4(aPos, 1.0f);
+		vertexFragmentPosition = vec3(model * vec4(aPos, 1.0f));
+
+		vertexNormal = mat3(transpose(inverse(model))) * normal;
+		vertexTextureCoordinate = textureCoordinate;
+		materialShininess = shininess;
+	}
+);
+
+// Vertex Shader Source : INSTANCED
+// same outputs as the vertex shader above, but model, normal matrix and shininess come in per instance
+// from the instance buffer (attribute divisor 1) instead of from uniforms
+const char* instancedVertexShaderSource =
+
+GLSL(440,
+
+	layout(location = 0) in vec3 aPos;
+	layout(location = 2) in vec2 textureCoordinate;
+	layout(location = 3) in vec3 normal;
+
+	layout(location = 4) in mat4 instanceModel; // takes locations 4-7
+	layout(location = 8) in mat3 instanceNormalMatrix; // takes locations 8-10
+	layout(location = 11) in float instanceShininess;
+
+	out vec2 vertexTextureCoordinate;
+	out vec3 vertexNormal;
+	out vec3 vertexFragmentPosition;
+	flat out float materialShininess;
+
+	layout(std140, binding = 0) uniform FrameData {
+		mat4 view;
+		mat4 projection;
+		vec4 viewPosition;
+	};
+
+	void main()
+	{
+		vec4 worldPosition = instanceModel * vec4(aPos, 1.0f);
+		gl_Position = projection * view * worldPosition;
+		vertexFragmentPosition = worldPosition.xyz;
+
+		vertexNormal = instanceNormalMatrix * normal; // normal matrix was built on the CPU once per instance
+		vertexTextureCoordinate = textureCoordinate;
+		materialShininess = instanceShininess;
+	}
+);
+
+// Vertex Shader Source : MULTI-DRAW INDIRECT
+// same outputs again, for meshes drawn out of the shared arena. Each draw in a glMultiDrawElementsIndirect
+// has one instance whose drawIndex attribute (divisor 1, started at the command's baseInstance) says which
+// record of the draw buffer holds its transform and material
+const char* indirectVertexShaderSource =
+
+GLSL(440,
+
+	layout(location = 0) in vec3 aPos;
+	layout(location = 2) in vec2 textureCoordinate;
+	layout(location = 3) in vec3 normal;
+	layout(location = 12) in uint drawIndex;
+
+	out vec2 vertexTextureCoordinate;
+	out vec3 vertexNormal;
+	out vec3 vertexFragmentPosition;
+	flat out float materialShininess;
+
+	layout(std140, binding = 0) uniform FrameData {
+		mat4 view;
+		mat4 projection;
+		vec4 viewPosition;
+	};
+
+	// per draw records (binding 2 = OpenGL::DRAW_BLOCK_BINDING), mirrors OpenGL::DrawRecord
+	struct DrawRecord {
+		mat4 model;
+		mat4 normalMatrix; // upper 3x3 used
+		vec4 material; // x shininess
+	};
+	layout(std430, binding = 2) readonly buffer DrawData {
+		DrawRecord draws[];
+	};
+
+	void main()
+	{
+		DrawRecord record = draws[drawIndex];
+		vec4 worldPosition = record.model * vec4(aPos, 1.0f);
+		gl_Position = projection * view * worldPosition;
+		vertexFragmentPosition = worldPosition.xyz;
+
+		vertexNormal = mat3(record.normalMatrix) * normal;
+		vertexTextureCoordinate = textureCoordinate;
+		materialShininess = record.material.x;
+	}
+);
+
+// Vertex Shader Source : PER VERTEX NORMAL MATRIX, INSTANCED
+// reference only, the instanced vertex shader inverting the instance model for every vertex
+const char* perVertexNormalInstancedShaderSource =
+
+GLSL(440,
+
+	layout(location = 0) in vec3 aPos;
+	layout(location = 2) in vec2 textureCoordinate;
+	layout(location = 3) in vec3 normal;
+
+	layout(location = 4) in mat4 instanceModel; // takes locations 4-7
+	layout(location = 11) in float instanceShininess;
+
+	out vec2 vertexTextureCoordinate;
+	out vec3 vertexNormal;
+	out vec3 vertexFragmentPosition;
+	flat out float materialShininess;
+
+	layout(std140, binding = 0) uniform FrameData {
+		mat4 view;
+		mat4 projection;
+		vec4 viewPosition;
+	};
+
+	void main()
+	{
+		vec4 worldPosition = instanceModel * vec4(aPos, 1.0f);
+		gl_Position = projection * view * worldPosition;
+		vertexFragmentPosition = worldPosition.xyz;
+
+		vertexNormal = mat3(transpose(inverse(instanceModel))) * normal;
+		vertexTextureCoordinate = textureCoordinate;
+		materialShininess = instanceShininess;
+	}
+);
+
+// Vertex Shader Source : PER VERTEX NORMAL MATRIX, MULTI-DRAW INDIRECT
+// reference only, the indirect vertex shader inverting the draw record's model for every vertex
+const char* perVertexNormalIndirectShaderSource =
+
+GLSL(440,
+
+	layout(location = 0) in vec3 aPos;
+	layout(location = 2) in vec2 textureCoordinate;
+	layout(location = 3) in vec3 normal;
+	layout(location = 12) in uint drawIndex;
+
+	out vec2 vertexTextureCoordinate;
+	out vec3 vertexNormal;
+	out vec3 vertexFragmentPosition;
+	flat out float materialShininess;
+
+	layout(std140, binding = 0) uniform FrameData {
+		mat4 view;
+		mat4 projection;
+		vec4 viewPosition;
+	};
+
+	struct DrawRecord {
+		mat4 model;
+		mat4 normalMatrix; // not read here
+		vec4 material; // x shininess
+	};
+	layout(std430, binding = 2) readonly buffer DrawData {
+		DrawRecord draws[];
+	};
+
+	void main()
+	{
+		DrawRecord record = draws[drawIndex];
+		vec4 worldPosition = record.model * vec4(aPos, 1.0f);
+		gl_Position = projection * view * worldPosition;
+		vertexFragmentPosition = worldPosition.xyz;
+
+		vertexNormal = mat3(transpose(inverse(record.model))) * normal;
+		vertexTextureCoordinate = textureCoordinate;
+		materialShininess = record.material.x;
 	}
 );
 
@@ -77,17 +329,21 @@ GLSL(440,
 	in vec3 vertexNormalPosition;
 	in vec3 vertexFragmentPosition;
 
-	uniform vec3 lightColor1;
-	uniform vec3 lightPos1;
-	uniform float lightStrength1;
-
-	uniform vec3 lightColor2;
-	uniform vec3 lightPos2;
-	uniform float lightStrength2;
+	// same camera block as the vertex shader
+	layout(std140, binding = 0) uniform FrameData {
+		mat4 view;
+		mat4 projection;
+		vec4 viewPosition;
+	};
 
-	uniform vec3 viewPosition;
+	// scene lights (binding 1 = OpenGL::LIGHT_BLOCK_BINDING). Array size must match OpenGL::MAX_LIGHTS
+	layout(std140, binding = 1) uniform LightData {
+		vec4 lightPosition[4]; // xyz position, w strength
+		vec4 lightColor[4];
+		int lightCount;
+	};
 
-	uniform float shininess; // this is the per material shininess
+	flat in float materialShininess; // this is the per material shininess, from whichever vertex shader ran
 
     out vec4 FragColor;
     uniform sampler2D uTexture;
@@ -102,27 +358,27 @@ void main()
 	vec3 ambientColor = vec3(1.0f, 1.0f, 1.0f);
 	vec3 ambient = ambientStrength * ambientColor; // Generate ambient light color
 	
-	// Calculate Diffuse lighting
+	// Calculate Diffuse and Specular lighting, summed over every light in the block
 	vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
-	vec3 lightDirection1 = normalize(lightPos1 - vertexFragmentPosition);
-	float impact1 = max(dot(norm, lightDirection1), 0.0);
-	vec3 lightDirection2 = normalize(lightPos2 - vertexFragmentPosition); 
-	float impact2 = max(dot(norm, lightDirection2), 0.0);
-	vec3 diffuse = impact1 * lightColor1 * lightStrength1 + impact2 * lightColor2 * lightStrength2; // Generate diffuse light color for two sources
-
-	// Calculate Specular lighting
-	float specularIntensity1 = 0.8f * lightStrength1 * shininess; // Set specular light strength
-	float specularIntensity2 = 0.8f * lightStrength2 * shininess;
-	float highlightSize = 16.0f * shininess; // Set specular highlight size.
-	vec3 viewDir = normalize(viewPosition - vertexFragmentPosition); // Calculate view direction
-	vec3 reflectDir1 = reflect(-lightDirection1, norm); // Calculate reflection vector light 1
-	vec3 reflectDir2 = reflect(-lightDirection2, norm); // Calculate reflection vector light 2
-	// Calculate specular component
-	float specularComponent1 = pow(max(dot(viewDir, reflectDir1), 0.0), highlightSize);
-	float specularComponent2 = pow(max(dot(viewDir, reflectDir2), 0.0), highlightSize);
-
-	// final specular map combines both light views by addition
-	vec3 specular = specularIntensity1 * specularComponent1 * lightColor1 + specularIntensity2 * specularComponent2 * lightColor2;
+	vec3 viewDir = normalize(viewPosition.xyz - vertexFragmentPosition); // Calculate view direction
+	float highlightSize = 16.0f * materialShininess; // Set specular highlight size.
+
+	vec3 diffuse = vec3(0.0f);
+	vec3 specular = vec3(0.0f);
+	for (int i = 0; i < lightCount; i++) {
+
+		vec3 color = lightColor[i].rgb;
+		float strength = lightPosition[i].w;
+
+		vec3 lightDirection = normalize(lightPosition[i].xyz - vertexFragmentPosition);
+		float impact = max(dot(norm, lightDirection), 0.0);
+		diffuse += impact * color * strength;
+
+		float specularIntensity = 0.8f * strength * materialShininess; // Set specular light strength
+		vec3 reflectDir = reflect(-lightDirection, norm); // Calculate reflection vector
+		float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
+		specular += specularIntensity * specularComponent * color;
+	}
 
 	// Texture holds the color to be used for all three components
 	//vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);
@@ -135,4 +391,45 @@ void main()
 	FragColor = vec4(phong, 1.0); 
 }
 );
+
+// HUD : screen space quads in pixels, colored and masked by the font atlas (one channel coverage)
+const char* hudVertexShaderSource =
+
+GLSL(440,
+
+	layout(location = 0) in vec2 position; // pixels from the top left
+	layout(location = 1) in vec2 uv;
+	layout(location = 2) in vec4 color;
+
+	out vec2 atlasCoordinate;
+	out vec4 quadColor;
+
+	uniform vec2 screenSize;
+
+	void main()
+	{
+		vec2 ndc = position / screenSize * 2.0f - 1.0f;
+		gl_Position = vec4(ndc.x, -ndc.y, 0.0f, 1.0f);
+		atlasCoordinate = uv;
+		quadColor = color;
+	}
+);
+
+const char* hudFragmentShaderSource =
+
+GLSL(440,
+
+	in vec2 atlasCoordinate;
+	in vec4 quadColor;
+
+	out vec4 FragColor;
+
+	uniform sampler2D atlas;
+
+	void main()
+	{
+		float coverage = texture(atlas, atlasCoordinate).r;
+		FragColor = vec4(quadColor.rgb, quadColor.a * coverage);
+	}
+);
 #endif
@@ -3,6 +3,8 @@
 
 #include "openGLmesh.h"
 #include <algorithm> //reverse vector
+#include <map>
+#include <string>
 
 /*
 * A collection of OpenGL Mesh shapes. These are a grouping of vertices and indices. The vertex array
@@ -11,6 +13,9 @@
 * 
 * All shapes here will be rendered as a collection of triangles as defined in the indices.
 * 
+* Each shape stamps a geometryKey (type + tessellation) so the controller uploads identical shapes only once.
+* Sphere and Cylinder also remember what they generated, so asking for the same tessellation again is a copy, not more trig.
+* 
 */
 
 namespace shapes {
@@ -54,6 +59,7 @@ namespace shapes {
 
 		pyramid.floatsPerVertex = 3;
 		pyramid.floatsPerColor = 4;
+		pyramid.geometryKey = "pyramid";
 
 		return pyramid;
 	}
@@ -117,6 +123,7 @@ namespace shapes {
 		cube.floatsPerColor = 4;
 		cube.floatsPerUV = 2;
 		cube.floatsPerNormal = 3;
+		cube.geometryKey = "cube";
 
 		return cube;
 	}
@@ -143,13 +150,19 @@ namespace shapes {
 		plane.floatsPerColor = 4;
 		plane.floatsPerUV = 2;
 		plane.floatsPerNormal = 3;
+		plane.geometryKey = "plane";
 
 		return plane;
 	}
 
 	OpenGLMesh Cylinder(int numSides) {
 
+		static std::map<int, OpenGLMesh> generated;
+		auto found = generated.find(numSides);
+		if (found != generated.end()) return found->second;
+
 		OpenGLMesh cylinder;
+		cylinder.geometryKey = "cylinder " + std::to_string(numSides);
 
 		cylinder.floatsPerVertex = 3;
 		cylinder.floatsPerColor = 0;
@@ -244,7 +257,7 @@ namespace shapes {
 
 		// define indices for drawing triangles 
 		// (i think we can skip this and call draw array to make an empty vertex combo and texture it anyway?)
-		std::vector<unsigned short> indices;
+		MeshIndices indices;
 
 		// top and bottom triangles
 		index = 1;  // start point for edge vertices (after center)
@@ -265,7 +278,7 @@ namespace shapes {
 		int t1 = b1 + 1;
 		int t2 = t1 + 2; // data at these locations goes {b1}{t1}{b2}{t2}...
 
-		for (int i = start; i <= numSides + start; i++) {
+		for (int i = start; i < numSides + start; i++) { // numSides quads, the last pair of side vertices closes the seam
 
 			indices.push_back(b1); 
 			indices.push_back(t1); 
@@ -281,6 +294,7 @@ namespace shapes {
 
 
 		// finish
+		generated[numSides] = cylinder;
 		return cylinder;
 	}
 
@@ -291,7 +305,12 @@ namespace shapes {
 		// i didnt want to complicate the render function so much, although I think doing so can save gpu memory
 		// the rest follows 
 
+		static std::map<std::pair<int, int>, OpenGLMesh> generated;
+		auto found = generated.find({ numSlices, numStacks });
+		if (found != generated.end()) return found->second;
+
 		OpenGLMesh sphere;
+		sphere.geometryKey = "sphere " + std::to_string(numSlices) + " " + std::to_string(numStacks);
 
 		sphere.floatsPerVertex = 3;
 		sphere.floatsPerColor = 0;
@@ -348,6 +367,7 @@ namespace shapes {
 		// build indices
 		// north pole
 		int numVertices = (numStacks + 1) * (numSlices + 1);
+		sphere.indices.widenFor(numVertices); // past 65536 vertices (256 x 256 and up) they need 32 bits
 		for (int i = 0; i < numSlices; i++) {
 
 			int nextIndex = i + numSlices + 1;
@@ -369,13 +389,14 @@ namespace shapes {
 			sphere.indices.push_back(nextIndex);
 		}
 
-		// rest of sphere
-		int t1 = numSlices + 1;
-		int t2 = t1 + 1;
-		int b1 = t1 + numSlices + 1;
-		int b2 = b1 + 1;
+		// rest of sphere, the rows between the two pole rows
+		// (each row has numSlices + 1 vertices, the last one repeats the first with u = 1)
+		for (int i = 1; i < numStacks - 1; i++) {
 
-		for (int i = 0; i < numStacks; i++) {
+			int t1 = i * (numSlices + 1);
+			int t2 = t1 + 1;
+			int b1 = t1 + numSlices + 1;
+			int b2 = b1 + 1;
 
 			for (int j = 0; j < numSlices; j++) {
 
@@ -391,9 +412,33 @@ namespace shapes {
 			}
 		}
 
+		generated[{ numSlices, numStacks }] = sphere;
+		return sphere;
+	}
+
+
+	/*
+	* The same shapes with a level of detail chain in lods: re-tessellated at half the slices (and stacks) per level,
+	* down to what still reads as round. The controller draws whichever level fits the size on screen.
+	*/
+	OpenGLMesh SphereWithLods(int numSlices, int numStacks) {
+
+		OpenGLMesh sphere = Sphere(numSlices, numStacks);
+		for (int slices = numSlices / 2, stacks = numStacks / 2; slices >= 8 && stacks >= 6; slices /= 2, stacks /= 2) {
+			sphere.lods.push_back(Sphere(slices, stacks));
+		}
 		return sphere;
 	}
 
+	OpenGLMesh CylinderWithLods(int numSides) {
+
+		OpenGLMesh cylinder = Cylinder(numSides);
+		for (int sides = numSides / 2; sides >= 8; sides /= 2) {
+			cylinder.lods.push_back(Cylinder(sides));
+		}
+		return cylinder;
+	}
+
 }
 
 #endif
@@ -0,0 +1,193 @@
+#include "textureCache.h"
+
+#include <iostream>
+#include <algorithm>
+#include <thread>
+
+void TextureCache::Initialize() {
+
+	// mid grey 1x1 stand-in, bound for any texture that is still loading
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	glCreateTextures(GL_TEXTURE_2D, 1, &placeholder);
+	glTextureParameteri(placeholder, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(placeholder, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureStorage2D(placeholder, 1, GL_RGBA8, 1, 1);
+	glTextureSubImage2D(placeholder, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+
+	// leave a core for the GL thread
+	int threads = std::clamp((int)std::thread::hardware_concurrency() - 1, 1, 4);
+	loader.Start(threads);
+}
+
+GLuint TextureCache::Acquire(const std::string& path) {
+
+	if (requests == 0) firstRequest = std::chrono::steady_clock::now();
+	requests++;
+
+	// same path as before, nothing to read
+	auto byPath = mByPath.find(path);
+	if (byPath != mByPath.end()) {
+		TextureEntry& entry = mTextures[byPath->second];
+		entry.refCount++;
+		auto original = (entry.aliasOf != 0) ? mTextures.find(entry.aliasOf) : mTextures.end();
+		TextureEntry& credited = (original != mTextures.end()) ? original->second : entry;
+		credited.sharedUses++;
+		pathHits++;
+		return entry.texture;
+	}
+
+	// new path: create the texture object now (no storage yet), the loader fills it in later (or turns it into an alias)
+	TextureEntry entry = {};
+	glCreateTextures(GL_TEXTURE_2D, 1, &entry.texture);
+	entry.refCount = 1;
+	entry.loading = true;
+	mTextures[entry.texture] = entry;
+	mByPath[path] = entry.texture;
+
+	loader.Request(entry.texture, path);
+	pendingLoads++;
+	reported = false;
+	return entry.texture;
+}
+
+GLuint TextureCache::Resolve(GLuint texture) {
+
+	auto found = mTextures.find(texture);
+	if (found == mTextures.end()) return placeholder;
+	if (found->second.aliasOf != 0) return Resolve(found->second.aliasOf);
+	return found->second.resident ? texture : placeholder;
+}
+
+bool TextureCache::Pump() {
+
+	if (pendingLoads == 0) return false;
+
+	std::vector<DecodedImage> finished = loader.Pump(UPLOAD_BUDGET_BYTES);
+	for (auto& image : finished) {
+
+		pendingLoads--;
+
+		auto found = mTextures.find(image.texture);
+		if (found == mTextures.end()) continue;
+		TextureEntry& entry = found->second;
+		entry.loading = false;
+
+		if (entry.released) {
+			// nobody wants it any more, and later requests for these contents must not alias a deleted name
+			loader.Forget(image.texture);
+			glDeleteTextures(1, &image.texture);
+			mTextures.erase(found);
+			continue;
+		}
+
+		if (image.error != "") {
+			// not fatal, the shapes keep the placeholder. Dropping the claim lets a later request try the file again
+			std::cout << "WARNING: " << image.error << ", drawing it with the placeholder texture" << std::endl;
+			loader.Forget(image.texture);
+			continue;
+		}
+
+		if (image.aliasOf != 0) {
+			auto original = mTextures.find(image.aliasOf);
+			if (original == mTextures.end() || original->second.released) {
+				// the original went away after the worker matched it: decode this one after all
+				loader.Forget(image.aliasOf);
+				loader.Request(image.texture, image.path);
+				entry.loading = true;
+				pendingLoads++;
+				continue;
+			}
+
+			// same bytes as another texture: drop the reserved name and hold a reference on the original instead
+			glDeleteTextures(1, &entry.texture);
+			entry.aliasOf = image.aliasOf;
+			original->second.refCount++;
+			original->second.sharedUses += entry.sharedUses + 1;
+			duplicateDecodeMs += image.decodeMs; // matched by its pixels, after decoding
+			contentHits++;
+			continue;
+		}
+
+		entry.resident = true;
+		entry.width = image.width;
+		entry.height = image.height;
+		entry.channels = image.channels;
+		entry.byteSize = (GLsizeiptr)image.width * image.height * image.channels * 4 / 3; // a full mip chain adds about a third
+		entry.decodeMs = image.decodeMs;
+	}
+
+	if (pendingLoads == 0 && !reported) {
+		printStats();
+		reported = true;
+	}
+	return !finished.empty();
+}
+
+void TextureCache::Release(GLuint texture) {
+
+	auto found = mTextures.find(texture);
+	if (found == mTextures.end()) return;
+	if (--found->second.refCount > 0) return;
+
+	TextureEntry entry = found->second;
+
+	// forget every path that pointed at it, then the texture itself
+	for (auto it = mByPath.begin(); it != mByPath.end();) {
+		if (it->second == texture) it = mByPath.erase(it);
+		else ++it;
+	}
+
+	if (entry.loading) {
+		// the loader still hands it back, Pump deletes the name and drops the content claim then
+		found->second.released = true;
+		return;
+	}
+
+	mTextures.erase(found);
+	if (entry.aliasOf != 0) {
+		Release(entry.aliasOf); // the alias held one reference on the original
+	}
+	else {
+		if (entry.resident) loader.Forget(texture);
+		glDeleteTextures(1, &texture); // a failed load still owns its reserved name
+	}
+}
+
+GLsizeiptr TextureCache::getResidentBytes() const {
+	GLsizeiptr bytes = 0;
+	for (auto& texture : mTextures) {
+		if (texture.second.resident) bytes += texture.second.byteSize;
+	}
+	return bytes;
+}
+
+void TextureCache::printStats() {
+
+	// every shared use of an image saved one decode and one copy of it on the GPU
+	int decoded = 0;
+	GLsizeiptr bytesUploaded = 0;
+	GLsizeiptr bytesSaved = 0;
+	double decodeMsSpent = 0.0;
+	double decodeMsSaved = 0.0;
+	for (auto& texture : mTextures) {
+		const TextureEntry& entry = texture.second;
+		if (!entry.resident) continue;
+		decoded++;
+		bytesUploaded += entry.byteSize;
+		bytesSaved += entry.byteSize * entry.sharedUses;
+		decodeMsSpent += entry.decodeMs;
+		decodeMsSaved += entry.decodeMs * entry.sharedUses;
+	}
+
+	// a match on pixels was decoded anyway, only the upload was saved
+	decodeMsSpent += duplicateDecodeMs;
+	decodeMsSaved -= duplicateDecodeMs;
+
+	double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - firstRequest).count();
+
+	std::cout << "INFO: Texture cache: " << requests << " requests, " << decoded << " decoded ("
+		<< pathHits << " path hits, " << contentHits << " content hits), "
+		<< bytesUploaded / 1024 << " KB on GPU, " << bytesSaved / 1024 << " KB and "
+		<< decodeMsSaved << " ms of decoding saved (" << decodeMsSpent << " ms spent on workers), "
+		<< "all resident " << loadMs << " ms after the first request" << std::endl;
+}
@@ -0,0 +1,86 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <GL\glew.h>
+
+#include "textureLoader.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <chrono>
+
+/*
+* Registry of loaded textures. A path that was already requested returns the same texture without touching
+* the disk again. New paths get a texture name right away and are handed to the TextureLoader, which decodes
+* them on worker threads and streams them in through PBOs. If the file turns out to hold the same image as
+* one we already have, the new name becomes an alias of that texture and the upload and the mip generation are
+* skipped. Same bytes (the file copied under another name) is found before decoding, so the decode is skipped
+* too. Same pixels from different bytes (saved as PNG and as JPG, encoded again) is only found after it.
+*
+* Until a texture is resident, Resolve returns a 1x1 placeholder, so meshes can render from the first frame.
+* A file that cannot be read or decoded is reported and stays on the placeholder.
+* Textures are reference counted and deleted with their last user. Once loading finishes the cache reports
+* how much GPU memory and decode time the sharing saved.
+*/
+
+struct TextureEntry {
+	GLuint texture; // the name meshes hold on to
+	GLuint aliasOf; // != 0 if this path had the same image as another texture
+	bool resident;
+	bool loading; // handed to the loader and not back yet
+	int width;
+	int height;
+	int channels;
+	GLsizeiptr byteSize; // GPU bytes including the mip chain
+	double decodeMs; // what it cost to decode this image once
+	int refCount;
+	int sharedUses; // requests served by this image without decoding it again
+	bool released; // last reference went while it was loading, Pump deletes it when the loader hands it back
+};
+
+class TextureCache {
+
+	public:
+
+		// placeholder texture and loader threads, needs a current GL context
+		void Initialize();
+
+		// returns a texture name for the image file right away, loading happens in the background
+		GLuint Acquire(const std::string& path);
+		void Release(GLuint texture);
+
+		// what to bind for a texture right now: the real image once it is resident, the placeholder until then
+		GLuint Resolve(GLuint texture);
+
+		// GL thread, once per frame. True if any texture became resident, so bindings should be resolved again
+		bool Pump();
+		bool Loading() { return pendingLoads > 0; }
+
+		// GPU bytes of the resident textures, mip chains included
+		GLsizeiptr getResidentBytes() const;
+
+		void printStats();
+
+	private:
+
+		// upload at most this much per frame, so a burst of big images does not spike one frame
+		static const size_t UPLOAD_BUDGET_BYTES = 8 * 1024 * 1024;
+
+		TextureLoader loader;
+		GLuint placeholder = 0;
+
+		std::unordered_map<GLuint, TextureEntry> mTextures;
+		std::unordered_map<std::string, GLuint> mByPath;
+
+		// counters for the report
+		int requests = 0;
+		int pathHits = 0;
+		int contentHits = 0;
+		double duplicateDecodeMs = 0.0; // decodes that only then turned out to be an image we had
+		int pendingLoads = 0;
+		bool reported = false;
+		std::chrono::steady_clock::time_point firstRequest;
+};
+
+#endif
@@ -0,0 +1,242 @@
+#include "textureLoader.h"
+#include "hash.h"
+
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+void TextureLoader::Start(int numThreads) {
+
+	for (int i = 0; i < NUM_PIXEL_BUFFERS; i++) {
+		glCreateBuffers(1, &mPixelBuffers[i].buffer);
+	}
+
+	stopping = false;
+	for (int i = 0; i < numThreads; i++) {
+		mWorkers.push_back(std::thread(&TextureLoader::WorkerLoop, this));
+	}
+}
+
+void TextureLoader::Stop() {
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		stopping = true;
+	}
+	mWakeUp.notify_all();
+	for (auto& worker : mWorkers) worker.join();
+	mWorkers.clear();
+
+	// anything decoded but never uploaded still owns stb memory
+	for (auto& image : mDecoded) stbi_image_free(image.pixels);
+	for (auto& image : mUploadQueue) stbi_image_free(image.pixels);
+	mDecoded.clear();
+	mUploadQueue.clear();
+}
+
+void TextureLoader::Request(GLuint texture, const std::string& path) {
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRequests.push_back({ texture, path });
+	}
+	mWakeUp.notify_one();
+}
+
+void TextureLoader::Forget(GLuint texture) {
+
+	// a texture can hold a file claim and a pixel claim, and file claims of other names that decoded to its pixels
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (auto it = mClaimedContent.begin(); it != mClaimedContent.end();) {
+		if (it->second == texture) it = mClaimedContent.erase(it);
+		else ++it;
+	}
+}
+
+bool TextureLoader::Idle() {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mRequests.empty() && mDecoded.empty() && busyWorkers == 0 && mUploadQueue.empty();
+}
+
+void TextureLoader::WorkerLoop() {
+
+	// flip per thread, the global stb flag is not safe to share between workers
+	stbi_set_flip_vertically_on_load_thread(true);
+
+	while (true) {
+
+		PendingRequest request;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeUp.wait(lock, [this] { return stopping || !mRequests.empty(); });
+			if (stopping) return;
+			request = mRequests.front();
+			mRequests.pop_front();
+			busyWorkers++;
+		}
+
+		DecodedImage image = Decode(request);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDecoded.push_back(image);
+			busyWorkers--;
+		}
+	}
+}
+
+DecodedImage TextureLoader::Decode(const PendingRequest& request) {
+
+	DecodedImage image = {};
+	image.texture = request.texture;
+	image.path = request.path;
+
+	std::ifstream file(request.path, std::ios::binary);
+	if (!file) {
+		image.error = "Could not load image " + request.path;
+		return image;
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	std::string fileBytes = contents.str();
+
+	image.fileHash = FNV_OFFSET_BASIS;
+	hashBytes(image.fileHash, fileBytes.data(), fileBytes.size());
+
+	// the first request with these bytes claims them, any later one becomes an alias and skips the decode
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto claimed = mClaimedContent.find(image.fileHash);
+		if (claimed != mClaimedContent.end()) {
+			image.aliasOf = claimed->second;
+			return image;
+		}
+		mClaimedContent[image.fileHash] = request.texture;
+	}
+
+	auto decodeStart = std::chrono::steady_clock::now();
+	image.pixels = stbi_load_from_memory((const stbi_uc*)fileBytes.data(), (int)fileBytes.size(), &image.width, &image.height, &image.channels, 0);
+	image.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
+
+	if (!image.pixels) {
+		image.error = "Could not load image " + request.path;
+	}
+	else if (image.channels != 3 && image.channels != 4) {
+		image.error = "Cannot handle channels other than 3 or 4";
+		stbi_image_free(image.pixels);
+		image.pixels = nullptr;
+	}
+	if (image.pixels == nullptr) return image;
+
+	// different bytes can still be the same image (another format, encoded again): match the pixels as well
+	int shape[3] = { image.width, image.height, image.channels };
+	image.pixelHash = FNV_OFFSET_BASIS;
+	hashBytes(image.pixelHash, shape, sizeof(shape));
+	hashBytes(image.pixelHash, image.pixels, (size_t)image.width * image.height * image.channels);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto claimed = mClaimedContent.find(image.pixelHash);
+	if (claimed != mClaimedContent.end()) {
+		// decoded for nothing, but the upload is still saved. Later requests with these bytes go straight to the original
+		image.aliasOf = claimed->second;
+		mClaimedContent[image.fileHash] = claimed->second;
+		stbi_image_free(image.pixels);
+		image.pixels = nullptr;
+		return image;
+	}
+	mClaimedContent[image.pixelHash] = request.texture;
+	return image;
+}
+
+std::vector<DecodedImage> TextureLoader::Pump(size_t uploadBudgetBytes) {
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		while (!mDecoded.empty()) {
+			mUploadQueue.push_back(mDecoded.front());
+			mDecoded.pop_front();
+		}
+	}
+
+	std::vector<DecodedImage> finished;
+	size_t uploadedBytes = 0;
+
+	while (!mUploadQueue.empty()) {
+
+		DecodedImage& image = mUploadQueue.front();
+
+		// aliases and failures have nothing to upload
+		if (image.pixels != nullptr) {
+			if (uploadedBytes > 0 && uploadedBytes >= uploadBudgetBytes) break; // rest waits for next frame
+			if (!Upload(image)) break; // ring is full, the GPU has not consumed the oldest buffer yet
+			uploadedBytes += (size_t)image.width * image.height * image.channels;
+		}
+
+		finished.push_back(image);
+		mUploadQueue.pop_front();
+	}
+	return finished;
+}
+
+bool TextureLoader::Upload(DecodedImage& image) {
+
+	PixelBuffer& pixelBuffer = mPixelBuffers[nextPixelBuffer];
+	if (pixelBuffer.fence != 0) {
+		if (glClientWaitSync(pixelBuffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED) return false;
+		glDeleteSync(pixelBuffer.fence);
+		pixelBuffer.fence = 0;
+	}
+
+	GLsizeiptr byteSize = (GLsizeiptr)image.width * image.height * image.channels;
+
+	// copy the decoded pixels into the PBO, growing it if this image is the biggest so far
+	// (mutable storage on purpose, the ring buffers get reallocated when they grow)
+	if (byteSize > pixelBuffer.capacity) {
+		glNamedBufferData(pixelBuffer.buffer, byteSize, NULL, GL_STREAM_DRAW);
+		pixelBuffer.capacity = byteSize;
+	}
+	void* destination = glMapNamedBufferRange(pixelBuffer.buffer, 0, byteSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (destination == nullptr) {
+		// out of memory or a lost context: hand it back as a failure instead of writing through null
+		image.error = "Could not map a pixel buffer for " + image.path;
+		stbi_image_free(image.pixels);
+		image.pixels = nullptr;
+		return true;
+	}
+	std::memcpy(destination, image.pixels, byteSize);
+	glUnmapNamedBuffer(pixelBuffer.buffer);
+
+	stbi_image_free(image.pixels);
+	image.pixels = nullptr;
+
+	// immutable storage with the full mip chain, then level 0 from the PBO. The texture is addressed by name
+	// so whatever the render loop has bound stays bound
+	GLsizei levels = 1;
+	for (int size = std::max(image.width, image.height); size > 1; size >>= 1) levels++;
+	glTextureStorage2D(image.texture, levels, (image.channels == 3) ? GL_RGB8 : GL_RGBA8, image.width, image.height);
+
+	// Set the texture wrapping parameters.
+	glTextureParameteri(image.texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(image.texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// Set texture filtering parameters.
+	glTextureParameteri(image.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(image.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// the unpack buffer binding is the one bind DSA cannot avoid, it is only used here
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.buffer);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB rows are not always a multiple of 4 bytes
+	glTextureSubImage2D(image.texture, 0, 0, 0, image.width, image.height,
+		(image.channels == 3) ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, (void*)0); // data pointer is an offset into the PBO
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glGenerateTextureMipmap(image.texture);
+
+	pixelBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	nextPixelBuffer = (nextPixelBuffer + 1) % NUM_PIXEL_BUFFERS;
+	return true;
+}
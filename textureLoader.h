@@ -0,0 +1,97 @@
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include <GL\glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+* Background texture loading. Worker threads read, hash and decode image files with stb_image while the
+* GL thread keeps rendering. The GL thread calls Pump once per frame, which copies finished images into a
+* small ring of pixel buffer objects and specifies the textures from there, a few per frame, so the driver
+* can do the transfer without stalling the frame on a big glTexImage2D.
+*
+* Workers also check contents against everything already claimed, so the same image under two names is only
+* uploaded once. The duplicate comes back as an alias of the first texture. A file with the same bytes as a claimed
+* one is caught before decoding. Otherwise the decoded pixels (with their size and channel count) are matched too,
+* which catches the same image saved in another format or encoded again, at the cost of that decode.
+*/
+
+// one finished request, as handed from a worker to the GL thread
+struct DecodedImage {
+	GLuint texture; // the name reserved when the request was made
+	GLuint aliasOf; // != 0 if the contents matched another request, nothing to upload
+	std::string path;
+	unsigned char* pixels; // stb owned until uploaded
+	int width;
+	int height;
+	int channels;
+	double decodeMs; // 0 if it was matched by its file bytes and never decoded
+	uint64_t fileHash;
+	uint64_t pixelHash; // over width, height, channels and pixels, 0 if not decoded
+	std::string error; // empty unless the file could not be read or decoded
+};
+
+class TextureLoader {
+
+	public:
+
+		~TextureLoader() { Stop(); }
+
+		// spin up workers and the PBO ring (needs a current GL context)
+		void Start(int numThreads);
+		void Stop();
+
+		// queue a file for decoding into an already reserved texture name
+		void Request(GLuint texture, const std::string& path);
+
+		// GL thread: upload finished images within a byte budget, returns what became resident (or aliased) this call
+		std::vector<DecodedImage> Pump(size_t uploadBudgetBytes);
+
+		bool Idle(); // nothing queued, decoding or waiting for upload
+
+		// the texture is gone (or never got its contents), a later request with the same contents has to decode them again
+		void Forget(GLuint texture);
+
+	private:
+
+		struct PendingRequest {
+			GLuint texture;
+			std::string path;
+		};
+
+		struct PixelBuffer {
+			GLuint buffer = 0;
+			GLsizeiptr capacity = 0;
+			GLsync fence = 0; // set after the upload that last used this buffer
+		};
+
+		void WorkerLoop();
+		DecodedImage Decode(const PendingRequest& request);
+		bool Upload(DecodedImage& image); // false if the next PBO is still in flight, sets image.error if it cannot be mapped
+
+		std::vector<std::thread> mWorkers;
+		std::mutex mMutex;
+		std::condition_variable mWakeUp;
+		bool stopping = false;
+		int busyWorkers = 0;
+
+		std::deque<PendingRequest> mRequests; // guarded by mMutex
+		std::deque<DecodedImage> mDecoded; // guarded by mMutex
+		std::unordered_map<uint64_t, GLuint> mClaimedContent; // file and pixel hashes to their texture, guarded by mMutex
+
+		std::deque<DecodedImage> mUploadQueue; // GL thread only
+
+		static const int NUM_PIXEL_BUFFERS = 3;
+		PixelBuffer mPixelBuffers[NUM_PIXEL_BUFFERS];
+		int nextPixelBuffer = 0;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "uniforms.h"
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+
+void UniformTable::Reflect(GLuint programID) {
+
+	program = programID;
+	mUniforms.clear();
+
+	GLint count = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<GLchar> nameBuffer(maxNameLength + 1);
+
+	for (GLint i = 0; i < count; i++) {
+
+		GLsizei nameLength = 0;
+		UniformInfo info;
+		glGetActiveUniform(programID, i, (GLsizei)nameBuffer.size(), &nameLength, &info.size, &info.type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), nameLength);
+		info.location = glGetUniformLocation(programID, name.c_str()); // block members report -1 here, which is what we want
+
+		// arrays are reported as "name[0]", register the bare name too so both spellings resolve
+		mUniforms[name] = info;
+		auto bracket = name.find("[0]");
+		if (bracket != std::string::npos && bracket + 3 == name.size()) {
+			mUniforms[name.substr(0, bracket)] = info;
+		}
+	}
+}
+
+void UniformTable::printUniforms() {
+
+	for (auto& uniform : mUniforms) {
+		std::cout << uniform.first << " loc=" << uniform.second.location
+			<< " type=0x" << std::hex << uniform.second.type << std::dec
+			<< " size=" << uniform.second.size << std::endl;
+	}
+}
+
+void UniformBuffer::Create(GLuint bindingPoint, GLsizeiptr size) {
+
+	binding = bindingPoint;
+	mShadow.clear(); // first Update always uploads
+
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, size, NULL, GL_DYNAMIC_STORAGE_BIT); // fixed size, updated with glNamedBufferSubData
+
+	Bind();
+}
+
+void UniformBuffer::Bind() const {
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+bool UniformBuffer::Update(const void* data, GLsizeiptr size) {
+
+	if (mShadow.size() == (size_t)size && std::memcmp(mShadow.data(), data, size) == 0) return false;
+
+	mShadow.assign((const unsigned char*)data, (const unsigned char*)data + size);
+
+	glNamedBufferSubData(buffer, 0, size, data);
+	return true;
+}
+
+void UniformRing::Create(GLuint bindingPoint, GLsizeiptr size) {
+
+	binding = bindingPoint;
+	this->size = size;
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	stride = (size + alignment - 1) / alignment * alignment;
+
+	// coherent: plain CPU writes are visible to draws issued after them, no flush or unmap needed
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, stride * SLOTS, NULL, flags);
+	mapped = (unsigned char*)glMapNamedBufferRange(buffer, 0, stride * SLOTS, flags);
+	if (mapped == nullptr) throw std::runtime_error("Could not map the uniform ring");
+	slot = SLOTS - 1; // the first Next() lands on slot 0
+}
+
+void* UniformRing::Next() {
+
+	slot = (slot + 1) % SLOTS;
+
+	// normally signalled long ago, this only waits if the GPU is more than SLOTS frames behind
+	if (fences[slot] != 0) {
+		while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+	}
+	return mapped + stride * slot;
+}
+
+void UniformRing::Bind() const {
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, stride * slot, size);
+}
+
+void UniformRing::Fence() {
+	if (fences[slot] != 0) glDeleteSync(fences[slot]);
+	fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
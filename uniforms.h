@@ -0,0 +1,139 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <GL\glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+* Uniform reflection for a linked shader program. Every active uniform is enumerated once with glGetActiveUniform
+* right after the program links, so nothing in the render loop has to ask the driver for a location by name.
+*
+* The table hands out Uniform<T> handles, which are just a resolved location with a typed set(). A handle for a
+* uniform the program does not use (optimized out, misspelled) keeps location -1, and setting it is a no-op in GL.
+*
+*/
+
+// what the driver reported about one active uniform
+struct UniformInfo {
+	GLint location;
+	GLenum type;
+	GLint size; // > 1 for arrays
+};
+
+template <typename T>
+class Uniform {
+
+	public:
+
+		Uniform() : location(-1) {}
+		explicit Uniform(GLint location) : location(location) {}
+
+		// upload to the currently bound program (glUseProgram must already point at the owner)
+		void set(const T& value) const;
+
+		bool valid() const { return location != -1; }
+		GLint getLocation() const { return location; }
+
+	private:
+
+		GLint location;
+};
+
+template <> inline void Uniform<glm::mat4>::set(const glm::mat4& value) const { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+template <> inline void Uniform<glm::mat3>::set(const glm::mat3& value) const { glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+template <> inline void Uniform<glm::vec2>::set(const glm::vec2& value) const { glUniform2f(location, value.x, value.y); }
+template <> inline void Uniform<glm::vec3>::set(const glm::vec3& value) const { glUniform3f(location, value.x, value.y, value.z); }
+template <> inline void Uniform<float>::set(const float& value) const { glUniform1f(location, value); }
+template <> inline void Uniform<GLint>::set(const GLint& value) const { glUniform1i(location, value); }
+
+class UniformTable {
+
+	public:
+
+		// enumerate all active uniforms of a linked program
+		void Reflect(GLuint programID);
+
+		// typed handle lookup. Done once after build, never per draw
+		template <typename T>
+		Uniform<T> get(const std::string& name) const {
+			auto found = mUniforms.find(name);
+			if (found == mUniforms.end()) return Uniform<T>();
+			return Uniform<T>(found->second.location);
+		}
+
+		bool has(const std::string& name) const { return mUniforms.count(name) != 0; }
+		GLuint getProgram() const { return program; }
+
+		// mostly for debugging
+		void printUniforms();
+
+	private:
+
+		GLuint program = 0;
+		std::unordered_map<std::string, UniformInfo> mUniforms;
+};
+
+/*
+* A uniform block buffer attached to a fixed binding point (the shaders declare the same binding with layout(binding = N)).
+* Update keeps a CPU copy of the last upload and skips the glNamedBufferSubData when nothing changed, so callers can
+* hand it their block every frame and only pay for real edits.
+*/
+class UniformBuffer {
+
+	public:
+
+		void Create(GLuint bindingPoint, GLsizeiptr size);
+		void Bind() const;
+
+		// returns true if the data differed and was sent to the GPU
+		bool Update(const void* data, GLsizeiptr size);
+
+		GLuint getBuffer() const { return buffer; }
+
+	private:
+
+		GLuint buffer = 0;
+		GLuint binding = 0;
+		std::vector<unsigned char> mShadow; // last uploaded contents
+};
+
+/*
+* A uniform block written in place through a persistent, coherent mapping, for data that should be as fresh as possible
+* when the draws are issued. Each frame writes the next of SLOTS copies and attaches it to the binding point, so the
+* CPU never overwrites a copy the GPU may still be reading. A fence per slot guards the wrap around.
+*/
+class UniformRing {
+
+	public:
+
+		static const int SLOTS = 3;
+
+		void Create(GLuint bindingPoint, GLsizeiptr size);
+
+		// the next slot to fill, once the GPU is done with it. Write the block, then Bind
+		void* Next();
+		void Bind() const;
+
+		// after the last draw that reads the current slot
+		void Fence();
+
+		bool created() const { return buffer != 0; }
+
+	private:
+
+		GLuint buffer = 0;
+		GLuint binding = 0;
+		GLsizeiptr size = 0;
+		GLsizeiptr stride = 0; // size rounded up to the uniform buffer offset alignment
+		unsigned char* mapped = nullptr;
+		GLsync fences[SLOTS] = {};
+		int slot = 0;
+};
+
+#endif
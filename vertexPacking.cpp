@@ -0,0 +1,120 @@
+#include "vertexPacking.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+static const float UNORM16_MAX = 65535.0f;
+static const float SNORM16_MAX = 32767.0f;
+
+bool CanPackVertices(const OpenGLMesh& mesh) {
+	return mesh.floatsPerVertex == 3 && mesh.floatsPerUV == 2 && mesh.floatsPerNormal == 3;
+}
+
+// the lower half of the octahedron is folded over the upper one, so the whole sphere fits in [-1, 1]^2
+static glm::vec2 OctEncode(glm::vec3 n) {
+	n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.0f) {
+		e = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	return e;
+}
+
+// same as OctDecode in packedVertexShaderSource
+static glm::vec3 OctDecode(glm::vec2 e) {
+	glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0.0f) {
+		n.x = (1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+		n.y = (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return glm::normalize(n);
+}
+
+static float Snorm16ToFloat(int16_t value) {
+	return std::max(value / SNORM16_MAX, -1.0f);
+}
+
+static void PackNormal(glm::vec3 normal, int16_t packed[2]) {
+
+	float length = glm::length(normal);
+	if (length == 0.0f) {
+		packed[0] = packed[1] = 0;
+		return;
+	}
+	normal /= length;
+
+	// rounding each half to the nearest step is not always the closest normal, so try the four around it
+	glm::vec2 e = glm::clamp(OctEncode(normal), -1.0f, 1.0f) * SNORM16_MAX;
+	float best = -2.0f;
+	for (int i = 0; i < 4; i++) {
+		int16_t x = (int16_t)((i & 1) ? std::ceil(e.x) : std::floor(e.x));
+		int16_t y = (int16_t)((i & 2) ? std::ceil(e.y) : std::floor(e.y));
+		float match = glm::dot(OctDecode(glm::vec2(Snorm16ToFloat(x), Snorm16ToFloat(y))), normal);
+		if (match > best) {
+			best = match;
+			packed[0] = x;
+			packed[1] = y;
+		}
+	}
+}
+
+PackedMesh PackVertices(const OpenGLMesh& mesh, PackingAccuracy* accuracy) {
+
+	PackedMesh packed;
+	if (!CanPackVertices(mesh)) return packed;
+
+	size_t stride = mesh.floatsPerVertex + mesh.floatsPerColor + mesh.floatsPerUV + mesh.floatsPerNormal;
+	size_t uvOffset = mesh.floatsPerVertex + mesh.floatsPerColor;
+	size_t normalOffset = uvOffset + mesh.floatsPerUV;
+	size_t nVertices = mesh.vertices.size() / stride;
+	if (nVertices == 0) return packed;
+
+	auto position = [&](size_t v) { return glm::vec3(mesh.vertices[v * stride], mesh.vertices[v * stride + 1], mesh.vertices[v * stride + 2]); };
+
+	glm::vec3 low = position(0), high = position(0);
+	for (size_t v = 1; v < nVertices; v++) {
+		low = glm::min(low, position(v));
+		high = glm::max(high, position(v));
+	}
+	packed.boundsMin = low;
+	packed.boundsSize = high - low;
+	for (int axis = 0; axis < 3; axis++) {
+		if (packed.boundsSize[axis] == 0.0f) packed.boundsSize[axis] = 1.0f; // flat: every vertex is at 0 anyway
+	}
+
+	PackingAccuracy measured;
+	packed.vertices.resize(nVertices);
+	for (size_t v = 0; v < nVertices; v++) {
+
+		PackedVertex& out = packed.vertices[v];
+		const GLfloat* in = &mesh.vertices[v * stride];
+
+		glm::vec3 unit = glm::clamp((position(v) - low) / packed.boundsSize, 0.0f, 1.0f);
+		for (int axis = 0; axis < 3; axis++) out.position[axis] = (uint16_t)std::lround(unit[axis] * UNORM16_MAX);
+		out.position[3] = 0;
+
+		out.uv[0] = glm::packHalf1x16(in[uvOffset]);
+		out.uv[1] = glm::packHalf1x16(in[uvOffset + 1]);
+
+		glm::vec3 normal(in[normalOffset], in[normalOffset + 1], in[normalOffset + 2]);
+		PackNormal(normal, out.normal);
+
+		// what the GPU will see, against what it was given
+		glm::vec3 decoded = low + glm::vec3(out.position[0], out.position[1], out.position[2]) / UNORM16_MAX * packed.boundsSize;
+		glm::vec3 positionError = glm::abs(decoded - position(v));
+		measured.positionError = std::max(measured.positionError, std::max(positionError.x, std::max(positionError.y, positionError.z)));
+		measured.uvError = std::max(measured.uvError, std::max(std::abs(glm::unpackHalf1x16(out.uv[0]) - in[uvOffset]),
+			std::abs(glm::unpackHalf1x16(out.uv[1]) - in[uvOffset + 1])));
+		if (glm::length(normal) > 0.0f) {
+			glm::vec3 decodedNormal = OctDecode(glm::vec2(Snorm16ToFloat(out.normal[0]), Snorm16ToFloat(out.normal[1])));
+			glm::vec3 unitNormal = glm::normalize(normal);
+			float angle = std::atan2(glm::length(glm::cross(decodedNormal, unitNormal)), glm::dot(decodedNormal, unitNormal)); // acos loses the small angles
+			measured.normalErrorDegrees = std::max(measured.normalErrorDegrees, glm::degrees(angle));
+		}
+	}
+
+	if (accuracy != nullptr) *accuracy = measured;
+	return packed;
+}
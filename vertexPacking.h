@@ -0,0 +1,46 @@
+#ifndef VERTEXPACKING_H
+#define VERTEXPACKING_H
+
+#include "openGLmesh.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+* Compact vertex format for textured meshes: 16 bytes a vertex instead of 32 (48 for the shapes that also carry
+* a color, which the texture shader never reads).
+*
+*   position  4 x 16 bit unsigned normalized, 0..1 across the mesh bounds (w unused, keeps the uv aligned)
+*   uv        2 x half float
+*   normal    2 x 16 bit signed normalized, octahedral: the unit sphere folded onto a square
+*
+* Positions reach the shader as 0..1, decode() maps them back to model space and is folded into the model matrix,
+* so only the normal needs decoding in the shader (packedVertexShaderSource).
+*/
+
+struct PackedVertex {
+	uint16_t position[4];
+	uint16_t uv[2];
+	int16_t normal[2];
+};
+
+struct PackedMesh {
+	std::vector<PackedVertex> vertices;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsSize = glm::vec3(1.0f);
+
+	glm::mat4 decode() const { return glm::translate(boundsMin) * glm::scale(boundsSize); }
+};
+
+// largest difference between a vertex and what its packed form decodes to
+struct PackingAccuracy {
+	float positionError = 0.0f; // model units
+	float uvError = 0.0f;
+	float normalErrorDegrees = 0.0f;
+};
+
+// needs 3 position, 2 uv and 3 normal floats a vertex
+bool CanPackVertices(const OpenGLMesh& mesh);
+PackedMesh PackVertices(const OpenGLMesh& mesh, PackingAccuracy* accuracy = nullptr);
+
+#endif